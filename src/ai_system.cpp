@@ -1,20 +1,949 @@
 // internal
 #include "ai_system.hpp"
+#include "physics_system.hpp"
+#include "debug_draw.hpp"
+
+// stlib
+#include <cfloat>
+#include <chrono>
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Microseconds since 'start', restarts the measurement
+static float lap_us(Clock::time_point& start)
+{
+	const Clock::time_point now = Clock::now();
+	const float us = (float)std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count() / 1000.f;
+	start = now;
+	return us;
+}
+
+// Agents per job of the steering pass, a multiple of four
+const size_t STEERING_GRAIN = 512;
+
+// Obstacles keep this much more room than their bounding circle in the flow field, about
+// half an eagle
+const float OBSTACLE_CLEARANCE = 30.f;
+
+// COLLISION_LAYER bits the target and the threat of every archetype are picked from
+const uint32_t archetype_target_layers[archetype_count] = { LAYER_PLAYER, LAYER_NONE, LAYER_NONE };
+const uint32_t archetype_threat_layers[archetype_count] = { LAYER_EATABLE, LAYER_PLAYER, LAYER_PLAYER | LAYER_DEADLY };
+
+// Tuning of the behavior trees
+const float EAGLE_DIVE_RANGE = 300.f; // eagles dive at a chicken closer than this
+const float EAGLE_GIVE_UP_RANGE = 450.f; // and stop diving when it gets away this far
+const float WIND_GUST_SPEED = 60.f; // wind faster than this throws eagles off course
+const float RIDE_WIND_MS = 1000.f;
+const float BUG_ALARM_RANGE = 100.f; // bugs panic when the chicken comes closer
+const float BUG_SCATTER_MS = 600.f;
+const float BUG_SCATTER_THREAT_WEIGHT = 2.f;
+
+// Plain bugs this close to the chicken pick the spot around them it was least near lately
+// and find their way there around the stones, until they arrive or it is far again
+const float BUG_FLEE_RANGE = 200.f;
+const float BUG_CALM_RANGE = 350.f;
+const float SAFE_SPOT_DISTANCE = 250.f;
+const int SAFE_SPOT_CANDIDATES = 8;
+const float SAFE_SPOT_MARGIN = 50.f; // from the window border
+const float SAFE_SPOT_REACHED = 30.f;
+const float SAFE_SPOT_FLOW_WEIGHT = 3.f; // the path has to beat cruising down
+
+// Steps until a destination without a path is asked for again, times the failures in a row
+const unsigned int PATH_RETRY_STEPS = 15;
+const unsigned int PATH_MAX_RETRY_FACTOR = 8;
+const float HOLD_SLOT_TARGET_WEIGHT = 4.f; // eagles barely pursue, holding a slot has to beat cruising
+
+// Tuning of the eagle target selection
+const float EAGLE_SIGHT = 900.f; // distances are scored relative to this
+const float FRONTIER_HEIGHT = 250.f; // the frontier runs this far above the chicken
+const float FRONTIER_HALF_WIDTH = 200.f;
+const float BUG_DANGER_RANGE = 300.f; // bugs closer to the chicken are worth blocking
+const int BUG_CANDIDATES = 3;
+
+// Radius and strength of the cones every agent adds to the influence maps, strengths are
+// picked so that a few agents together saturate the considerations reading them
+const float EAGLE_GUARD_RADIUS = 150.f;
+const float EAGLE_GUARD_STRENGTH = 0.5f;
+const float BUG_VALUE_RADIUS = 150.f;
+const float BUG_VALUE_STRENGTH = 0.35f;
+
+namespace {
+	// Options of the eagle reasoner
+	enum EAGLE_OPTION {
+		CHASE_CHICKEN = 0,
+		BLOCK_BUG = CHASE_CHICKEN + 1,
+		HOLD_FRONTIER = BLOCK_BUG + 1
+	};
+
+	// Null without one, valid until the next player is created or removed
+	const Entity* find_chicken()
+	{
+		for (const Entity& player : registry.players.entities)
+			if (registry.motions.has(player))
+				return &player;
+		return nullptr;
+	}
+
+	void chicken_candidate(const UtilityQuery&, std::vector<UtilityCandidate>& out_candidates)
+	{
+		const Entity* chicken = find_chicken();
+		if (chicken == nullptr)
+			return;
+		out_candidates.push_back(UtilityCandidate(*chicken));
+	}
+
+	// Results of the bug queries, reused since Entity() takes a new id. The decisions are
+	// evaluated on the main thread only.
+	Entity found_bugs[BUG_CANDIDATES];
+
+	void bug_candidates(const UtilityQuery& query, std::vector<UtilityCandidate>& out_candidates)
+	{
+		if (query.index == nullptr)
+			return;
+		float distances[BUG_CANDIDATES];
+		const size_t count = query.index->nearest_k(query.position, BUG_CANDIDATES, LAYER_EATABLE, found_bugs, distances);
+		for (size_t i = 0; i < count; i++)
+			out_candidates.push_back(UtilityCandidate(found_bugs[i]));
+	}
+
+	// The point above the chicken on the eagle's side, following the chicken
+	void frontier_candidate(const UtilityQuery& query, std::vector<UtilityCandidate>& out_candidates)
+	{
+		const Entity* chicken = find_chicken();
+		if (chicken == nullptr)
+			return;
+		const float dx = query.position.x - registry.motions.get(*chicken).position.x;
+		UtilityCandidate candidate(*chicken);
+		candidate.offset = { clamp(dx, -FRONTIER_HALF_WIDTH, FRONTIER_HALF_WIDTH), -FRONTIER_HEIGHT };
+		out_candidates.push_back(candidate);
+	}
+
+	float candidate_distance(const UtilityQuery& query)
+	{
+		vec2 position;
+		if (!get_candidate_position(query.candidate, position))
+			return 1.f;
+		return length(position - query.position) / EAGLE_SIGHT;
+	}
+
+	float chicken_alive(const UtilityQuery&)
+	{
+		const Entity* chicken = find_chicken();
+		if (chicken == nullptr || !registry.motionFlags.has(*chicken))
+			return 0.f;
+		return registry.motionFlags.get(*chicken).alive ? 1.f : 0.f;
+	}
+
+	float chicken_chasers(const UtilityQuery& query)
+	{
+		return query.option_share[CHASE_CHICKEN];
+	}
+
+	// 1 on the chicken, 0 from BUG_DANGER_RANGE on
+	float bug_near_chicken(const UtilityQuery& query)
+	{
+		vec2 bug;
+		if (query.influence == nullptr || !get_candidate_position(query.candidate, bug))
+			return 0.f;
+		return query.influence->chicken_proximity.sample(bug);
+	}
+
+	// Other eagles blocking bugs around the bug, leaving out roughly what the agent adds
+	// itself if it is one of them. Eagles chasing the chicken or holding the frontier don't
+	// count, they gather where the bugs worth blocking are.
+	float bug_guarded(const UtilityQuery& query)
+	{
+		vec2 bug;
+		if (query.influence == nullptr || !get_candidate_position(query.candidate, bug))
+			return 0.f;
+		const float guard = query.influence->eagle_guard.sample(bug);
+		if (query.current_option != BLOCK_BUG)
+			return guard;
+		return guard - InfluenceMap::falloff(length(bug - query.position), EAGLE_GUARD_RADIUS, EAGLE_GUARD_STRENGTH);
+	}
+
+	float bugs_near_candidate(const UtilityQuery& query)
+	{
+		vec2 position;
+		if (query.influence == nullptr || !get_candidate_position(query.candidate, position))
+			return 0.f;
+		return query.influence->bug_value.sample(position);
+	}
+
+	ResponseCurve linear(float slope, float y_shift)
+	{
+		ResponseCurve curve;
+		curve.slope = slope;
+		curve.y_shift = y_shift;
+		return curve;
+	}
+
+	// Unit direction in which the map falls off the fastest, 0 where it is flat
+	vec2 downhill(const InfluenceMap& map, vec2 position)
+	{
+		const vec2 gradient = map.gradient(position);
+		const float slope = length(gradient);
+		return slope > 1e-6f ? -gradient / slope : vec2(0, 0);
+	}
+
+	float distance_to_target(const BTContext& context)
+	{
+		const SteeringBatch& batch = context.batch;
+		const size_t i = context.slot;
+		if (batch.target_weight[i] == 0.f)
+			return FLT_MAX;
+		return length(vec2(batch.target_x[i] - batch.position_x[i], batch.target_y[i] - batch.position_y[i]));
+	}
+
+	float distance_to_threat(const BTContext& context)
+	{
+		const SteeringBatch& batch = context.batch;
+		const size_t i = context.slot;
+		if (batch.threat_weight[i] == 0.f)
+			return FLT_MAX;
+		return length(vec2(batch.threat_x[i] - batch.position_x[i], batch.threat_y[i] - batch.position_y[i]));
+	}
+
+	void set_weights(Blackboard& blackboard, float target, float threat, float flow)
+	{
+		blackboard.target_weight = target;
+		blackboard.threat_weight = threat;
+		blackboard.flow_weight = flow;
+	}
+
+	BT_STATUS caught_by_wind(BTContext& context)
+	{
+		if (!registry.blowables.has(context.entity))
+			return BT_STATUS::FAILURE;
+		const vec2 wind = registry.blowables.get(context.entity).wind_velocity;
+		return dot(wind, wind) > WIND_GUST_SPEED * WIND_GUST_SPEED ? BT_STATUS::SUCCESS : BT_STATUS::FAILURE;
+	}
+
+	// Let the gust carry the eagle for a moment instead of fighting it
+	BT_STATUS ride_wind(BTContext& context)
+	{
+		set_weights(context.blackboard, 0.f, 1.f, 0.f);
+		return context.blackboard.running_ms < RIDE_WIND_MS ? BT_STATUS::RUNNING : BT_STATUS::SUCCESS;
+	}
+
+	BT_STATUS target_in_dive_range(BTContext& context)
+	{
+		return distance_to_target(context) < EAGLE_DIVE_RANGE ? BT_STATUS::SUCCESS : BT_STATUS::FAILURE;
+	}
+
+	// Chase the target until it gets away or the eagle joins the frontier
+	BT_STATUS dive(BTContext& context)
+	{
+		set_weights(context.blackboard, 1.f, 1.f, 1.f);
+		if (context.blackboard.in_formation)
+			return BT_STATUS::FAILURE;
+		return distance_to_target(context) < EAGLE_GIVE_UP_RANGE ? BT_STATUS::RUNNING : BT_STATUS::FAILURE;
+	}
+
+	BT_STATUS in_formation(BTContext& context)
+	{
+		return context.blackboard.in_formation ? BT_STATUS::SUCCESS : BT_STATUS::FAILURE;
+	}
+
+	// Fly to the frontier slot and stay there, steering clear of bugs on the way
+	BT_STATUS hold_slot(BTContext& context)
+	{
+		set_weights(context.blackboard, HOLD_SLOT_TARGET_WEIGHT, 0.5f, 0.f);
+		return BT_STATUS::SUCCESS;
+	}
+
+	// Drift down along the flow field without chasing
+	BT_STATUS glide(BTContext& context)
+	{
+		set_weights(context.blackboard, 0.f, 1.f, 1.f);
+		return BT_STATUS::SUCCESS;
+	}
+
+	BT_STATUS chicken_in_alarm_range(BTContext& context)
+	{
+		return distance_to_threat(context) < BUG_ALARM_RANGE ? BT_STATUS::SUCCESS : BT_STATUS::FAILURE;
+	}
+
+	// Flee harder for a while, even once the chicken is out of the panic radius
+	BT_STATUS scatter(BTContext& context)
+	{
+		set_weights(context.blackboard, 1.f, BUG_SCATTER_THREAT_WEIGHT, 1.f);
+		return context.blackboard.running_ms < BUG_SCATTER_MS ? BT_STATUS::RUNNING : BT_STATUS::SUCCESS;
+	}
+
+	BT_STATUS heading_for_safe_spot(BTContext& context)
+	{
+		return registry.aiAgents.get(context.entity).fleeing ? BT_STATUS::SUCCESS : BT_STATUS::FAILURE;
+	}
+
+	// Follow the path to the safe spot, the flow of a bug with a destination
+	BT_STATUS run_for_safe_spot(BTContext& context)
+	{
+		set_weights(context.blackboard, 1.f, 1.f, SAFE_SPOT_FLOW_WEIGHT);
+		return BT_STATUS::SUCCESS;
+	}
+
+	BT_STATUS drift(BTContext& context)
+	{
+		set_weights(context.blackboard, 1.f, 1.f, 1.f);
+		return BT_STATUS::SUCCESS;
+	}
+}
+
+AISystem::AISystem(JobSystem& jobs_arg)
+	: jobs(jobs_arg)
+{
+	// Eagles drop towards where the chicken is going and swerve around bugs
+	SteeringArchetype& eagle = archetypes[(int)AGENT_ARCHETYPE::EAGLE];
+	eagle.max_speed = 140.f;
+	eagle.max_acceleration = 200.f;
+	eagle.cruise = 0.5f;
+	eagle.cruise_velocity = { 0.f, 100.f };
+	eagle.pursue = 0.2f;
+	eagle.follow_flow = 0.5f;
+	eagle.evade = 0.8f;
+	eagle.panic_radius = 120.f;
+	eagle.separation = 0.5f;
+	eagle.separation_radius = 120.f;
+
+	// Bugs keep falling, drift away from the chicken and scatter when it comes close
+	SteeringArchetype& bug = archetypes[(int)AGENT_ARCHETYPE::BUG];
+	bug.max_speed = 80.f;
+	bug.max_acceleration = 150.f;
+	bug.cruise = 1.f;
+	bug.cruise_velocity = { 0.f, 50.f };
+	bug.flee = 0.8f;
+	bug.panic_radius = 100.f;
+	bug.follow_flow = 0.4f; // away from where the chicken is and was
+	bug.separation = 0.3f;
+	bug.separation_radius = 60.f;
+
+	// Swarm bugs fly in flocks and flee from the chicken and the eagles alike
+	SteeringArchetype& swarm_bug = archetypes[(int)AGENT_ARCHETYPE::SWARM_BUG];
+	swarm_bug.max_speed = 90.f;
+	swarm_bug.max_acceleration = 250.f;
+	swarm_bug.cruise = 0.5f;
+	swarm_bug.cruise_velocity = { 0.f, 50.f };
+	swarm_bug.flee = 1.f;
+	swarm_bug.panic_radius = 120.f;
+	swarm_bug.follow_flow = 0.2f;
+	swarm_bug.separation = 0.6f;
+	swarm_bug.separation_radius = 25.f;
+	swarm_bug.alignment = 0.4f;
+	swarm_bug.cohesion = 0.3f;
+	swarm_bug.neighbor_radius = 70.f;
+
+	// Eagles go for the chicken unless enough of them do already, then they hold a line
+	// above it or snatch the bugs it's about to eat
+	ResponseCurve fewer_is_better = linear(-1.f, 1.f);
+	ResponseCurve crowding;
+	crowding.type = CURVE::POLYNOMIAL;
+	crowding.slope = -1.f;
+	crowding.exponent = 2.f;
+	crowding.y_shift = 1.f;
+	ResponseCurve danger;
+	danger.type = CURVE::LOGISTIC;
+	danger.slope = 12.f;
+	danger.x_shift = 0.5f;
+	std::vector<UtilityOption>& eagle_options = reasoners[(int)AGENT_ARCHETYPE::EAGLE].options;
+	eagle_options.resize(3);
+	eagle_options[CHASE_CHICKEN].candidates = chicken_candidate;
+	eagle_options[CHASE_CHICKEN].considerations = {
+		{ candidate_distance, fewer_is_better }, { chicken_alive, linear(1.f, 0.f) }, { chicken_chasers, crowding } };
+	eagle_options[BLOCK_BUG].weight = 1.f;
+	eagle_options[BLOCK_BUG].candidates = bug_candidates;
+	eagle_options[BLOCK_BUG].considerations = {
+		{ candidate_distance, fewer_is_better }, { bug_near_chicken, danger }, { bug_guarded, fewer_is_better } };
+	eagle_options[HOLD_FRONTIER].weight = 0.6f;
+	eagle_options[HOLD_FRONTIER].candidates = frontier_candidate;
+	eagle_options[HOLD_FRONTIER].considerations = {
+		{ candidate_distance, fewer_is_better }, { chicken_alive, linear(1.f, 0.f) }, { chicken_chasers, linear(0.8f, 0.2f) },
+		{ bugs_near_candidate, linear(0.5f, 0.5f) } };
+
+	BehaviorTree& eagle_tree = behavior_trees[(int)AGENT_ARCHETYPE::EAGLE];
+	eagle_tree.begin(BT_NODE::SELECTOR);
+		eagle_tree.begin(BT_NODE::SEQUENCE);
+			eagle_tree.add(BT_NODE::CONDITION, caught_by_wind);
+			eagle_tree.add(BT_NODE::ACTION, ride_wind);
+		eagle_tree.end();
+		eagle_tree.begin(BT_NODE::SEQUENCE);
+			eagle_tree.add(BT_NODE::CONDITION, in_formation);
+			eagle_tree.add(BT_NODE::ACTION, hold_slot);
+		eagle_tree.end();
+		eagle_tree.begin(BT_NODE::SEQUENCE);
+			eagle_tree.add(BT_NODE::CONDITION, target_in_dive_range);
+			eagle_tree.add(BT_NODE::ACTION, dive);
+		eagle_tree.end();
+		eagle_tree.add(BT_NODE::ACTION, glide);
+	eagle_tree.end();
+
+	for (AGENT_ARCHETYPE archetype : { AGENT_ARCHETYPE::BUG, AGENT_ARCHETYPE::SWARM_BUG })
+	{
+		BehaviorTree& bug_tree = behavior_trees[(int)archetype];
+		bug_tree.begin(BT_NODE::SELECTOR);
+			bug_tree.begin(BT_NODE::SEQUENCE);
+				bug_tree.add(BT_NODE::CONDITION, chicken_in_alarm_range);
+				bug_tree.add(BT_NODE::ACTION, scatter);
+			bug_tree.end();
+			bug_tree.begin(BT_NODE::SEQUENCE);
+				bug_tree.add(BT_NODE::CONDITION, heading_for_safe_spot);
+				bug_tree.add(BT_NODE::ACTION, run_for_safe_spot);
+			bug_tree.end();
+			bug_tree.add(BT_NODE::ACTION, drift);
+		bug_tree.end();
+	}
+}
+
+void AISystem::init(PhysicsSystem* physics_arg)
+{
+	this->physics = physics_arg;
+}
+
+void AISystem::update_flow_field()
+{
+	chicken_flow.begin_obstacles();
+	for (uint i = 0; i < registry.obstacles.size(); i++)
+	{
+		const Entity entity = registry.obstacles.entities[i];
+		if (!registry.motions.has(entity))
+			continue;
+		const Motion& motion = registry.motions.get(entity);
+		const vec2 half_size = abs(motion.scale) / 2.f;
+		chicken_flow.add_obstacle(motion.position, sqrt(dot(half_size, half_size)) + OBSTACLE_CLEARANCE,
+			registry.obstacles.components[i].cost);
+	}
+
+	// The field is shared by all agents chasing the chicken
+	for (Entity player : registry.players.entities)
+	{
+		if (registry.motions.has(player))
+		{
+			stats.flow_field_rebuilt = chicken_flow.update(registry.motions.get(player).position);
+			return;
+		}
+	}
+	chicken_flow.clear_goal();
+}
+
+void AISystem::update_influence(float elapsed_ms)
+{
+	influence.eagle_guard.decay(elapsed_ms);
+	influence.bug_value.decay(elapsed_ms);
+	influence.chicken_proximity.decay(elapsed_ms);
+
+	// Every agent, including the ones coasting in this step
+	auto& agent_registry = registry.aiAgents;
+	for (uint i = 0; i < agent_registry.size(); i++)
+	{
+		const Entity entity = agent_registry.entities[i];
+		if (!registry.motions.has(entity))
+			continue;
+		const vec2 position = registry.motions.get(entity).position;
+		if (agent_registry.components[i].archetype != AGENT_ARCHETYPE::EAGLE)
+			influence.bug_value.splat(position, BUG_VALUE_RADIUS, BUG_VALUE_STRENGTH);
+		else if (registry.utilityDecisions.has(entity) && registry.utilityDecisions.get(entity).option == BLOCK_BUG)
+			influence.eagle_guard.splat(position, EAGLE_GUARD_RADIUS, EAGLE_GUARD_STRENGTH);
+	}
+	for (Entity player : registry.players.entities)
+		if (registry.motions.has(player))
+			influence.chicken_proximity.splat(registry.motions.get(player).position, BUG_DANGER_RANGE, 1.f);
+}
+
+vec2 AISystem::follow_path(Entity entity, const AIAgent& agent, vec2 position)
+{
+	if (!registry.aiPaths.has(entity))
+		registry.aiPaths.emplace(entity);
+	AIPath& path = registry.aiPaths.get(entity);
+	const bool new_destination = path.destination != agent.destination;
+	// Without a path to the destination the planner is only asked again after a while
+	const bool retry = path.waypoints.empty() && step_count >= path.retry_step;
+	const bool outdated = !path.waypoints.empty() && path.version != plan.pathfinder_version;
+	if (!path.requested && (new_destination || retry || outdated))
+	{
+		path_requests.push_back({ entity, position, agent.destination });
+		path.requested = true;
+		stats.paths_requested++;
+	}
+	if (new_destination || path.waypoints.empty())
+	{
+		// Straight ahead until the planner comes back with a path, or if there is none
+		const vec2 to_destination = agent.destination - position;
+		const float distance = length(to_destination);
+		return distance > 1e-3f ? to_destination / distance : vec2(0, 0);
+	}
+
+	// Head for the first waypoint that isn't reached yet, the last one is the destination
+	const float reached = planner.get_path_cell_size();
+	while (path.next < path.waypoints.size() && length(path.waypoints[path.next] - position) < reached)
+		path.next++;
+	const vec2 to_next = (path.next < path.waypoints.size() ? path.waypoints[path.next] : agent.destination) - position;
+	const float distance = length(to_next);
+	return distance > 1e-3f ? to_next / distance : vec2(0, 0);
+}
+
+void AISystem::find_target_and_threat(size_t i, AGENT_ARCHETYPE archetype)
+{
+	if (physics == nullptr)
+		return;
+	const SpatialIndex& index = physics->get_spatial_index();
+	const vec2 position = { batch.position_x[i], batch.position_y[i] };
+	float distance;
+
+	// the utility reasoner of an archetype picks the targets instead
+	const uint32_t target_layers = reasoners[(int)archetype].empty() ? archetype_target_layers[(int)archetype] : LAYER_NONE;
+	if (target_layers != LAYER_NONE && index.nearest_k(position, 1, target_layers, &nearest, &distance) == 1 &&
+		registry.motions.has(nearest))
+	{
+		const Motion& motion = registry.motions.get(nearest);
+		batch.target_x[i] = motion.position.x;
+		batch.target_y[i] = motion.position.y;
+		batch.target_velocity_x[i] = motion.velocity.x;
+		batch.target_velocity_y[i] = motion.velocity.y;
+		batch.target_weight[i] = 1.f;
+	}
+
+	const uint32_t threat_layers = archetype_threat_layers[(int)archetype];
+	if (threat_layers != LAYER_NONE && index.nearest_k(position, 1, threat_layers, &nearest, &distance) == 1 &&
+		registry.motions.has(nearest))
+	{
+		const Motion& motion = registry.motions.get(nearest);
+		batch.threat_x[i] = motion.position.x;
+		batch.threat_y[i] = motion.position.y;
+		batch.threat_velocity_x[i] = motion.velocity.x;
+		batch.threat_velocity_y[i] = motion.velocity.y;
+		batch.threat_weight[i] = 1.f;
+	}
+}
+
+void AISystem::update_decisions(float elapsed_ms)
+{
+	// All agents with a reasoner take turns, whether they are updated in this step or not
+	decision_agents.clear();
+	urgent_agents.clear();
+	for (int k = 0; k < archetype_count; k++)
+		option_shares[k].assign(reasoners[k].options.size(), 0.f);
+	auto& agent_registry = registry.aiAgents;
+	for (uint i = 0; i < agent_registry.size(); i++)
+	{
+		const Entity entity = agent_registry.entities[i];
+		const int k = (int)agent_registry.components[i].archetype;
+		if (reasoners[k].empty() || !registry.motions.has(entity))
+			continue;
+		decision_agents.push_back(entity);
+		UtilityDecision& decision = registry.utilityDecisions.has(entity) ? registry.utilityDecisions.get(entity) :
+			registry.utilityDecisions.emplace(entity);
+		decision.age_ms += elapsed_ms;
+		stats.oldest_decision_ms = max(stats.oldest_decision_ms, decision.age_ms);
+		vec2 position;
+		if (decision.option >= 0)
+			option_shares[k][decision.option] += 1.f / stats.agents_per_archetype[k];
+		if (decision.option < 0 || !get_candidate_position(decision.candidate, position))
+			urgent_agents.push_back(entity);
+	}
+
+	const Clock::time_point start = Clock::now();
+	auto evaluate = [&](Entity entity) {
+		const int k = (int)registry.aiAgents.get(entity).archetype;
+		UtilityDecision& decision = registry.utilityDecisions.get(entity);
+		UtilityQuery query = { entity, registry.motions.get(entity).position,
+			physics != nullptr ? &physics->get_spatial_index() : nullptr, &influence, option_shares[k].data(), UtilityCandidate() };
+		// The shares follow every decision, agents deciding all at once on the same shares
+		// would all switch to the same option
+		const float share = 1.f / stats.agents_per_archetype[k];
+		if (decision.option >= 0)
+			option_shares[k][decision.option] -= share;
+		reasoners[k].decide(query, decision);
+		if (decision.option >= 0)
+			option_shares[k][decision.option] += share;
+		stats.decisions_evaluated++;
+	};
+	auto out_of_time = [&]() {
+		Clock::time_point now = start;
+		return stats.decisions_evaluated > 0 && lap_us(now) >= utility_budget_us;
+	};
+
+	// Agents without a decision or whose target is gone go first, then the others continue
+	// in turns where the last step ran out of time
+	for (Entity entity : urgent_agents)
+	{
+		if (out_of_time())
+			break;
+		evaluate(entity);
+	}
+	const size_t count = decision_agents.size();
+	if (decision_cursor >= count)
+		decision_cursor = 0;
+	for (size_t n = 0; n < count && !out_of_time(); n++)
+	{
+		const Entity entity = decision_agents[decision_cursor];
+		decision_cursor = (decision_cursor + 1) % count;
+		if (registry.utilityDecisions.get(entity).age_ms > 0.f)
+			evaluate(entity);
+	}
+	stats.decisions_reused = (unsigned int)count - stats.decisions_evaluated;
+
+	// The agents updated in this step follow their decision, even a stale one, unless the
+	// target is gone
+	for (int k = 0; k < archetype_count; k++)
+	{
+		if (reasoners[k].empty())
+			continue;
+		for (size_t slot = archetype_start[k]; slot < archetype_start[k + 1]; slot++)
+		{
+			if (!batch_used[slot])
+				continue;
+			const UtilityDecision& decision = registry.utilityDecisions.get(batch_entities[slot]);
+			vec2 position;
+			if (decision.option < 0 || !get_candidate_position(decision.candidate, position))
+				continue;
+			Entity target = decision.candidate.target;
+			const vec2 velocity = decision.candidate.has_target ? registry.motions.get(target).velocity : vec2(0, 0);
+			batch.target_x[slot] = position.x;
+			batch.target_y[slot] = position.y;
+			batch.target_velocity_x[slot] = velocity.x;
+			batch.target_velocity_y[slot] = velocity.y;
+			batch.target_weight[slot] = 1.f;
+		}
+	}
+}
+
+void AISystem::apply_plan()
+{
+	if (planner.take_result(plan))
+	{
+		const bool stale = step_count - plan.step > max_plan_age;
+		for (PlannedPath& planned : plan.paths)
+		{
+			if (!registry.aiPaths.has(planned.entity) || !registry.aiAgents.has(planned.entity))
+				continue;
+			AIPath& path = registry.aiPaths.get(planned.entity);
+			path.requested = false;
+			// Too old or for a destination the agent gave up on, it asks again
+			const AIAgent& agent = registry.aiAgents.get(planned.entity);
+			if (stale || !agent.has_destination || planned.destination != agent.destination)
+				continue;
+			if (planned.destination != path.destination)
+				path.failures = 0;
+			path.failures = planned.waypoints.empty() ? path.failures + 1 : 0;
+			path.retry_step = step_count + PATH_RETRY_STEPS * min(path.failures, PATH_MAX_RETRY_FACTOR);
+			path.waypoints.swap(planned.waypoints);
+			path.next = 0;
+			path.destination = planned.destination;
+			path.version = plan.pathfinder_version;
+			stats.paths_planned++;
+		}
+	}
+	if (plan.valid)
+	{
+		stats.plan_age = step_count - plan.step;
+		stats.plan_stale = stats.plan_age > max_plan_age;
+		stats.plan_us = plan.plan_us;
+	}
+}
+
+void AISystem::publish_snapshot(const Entity* chicken)
+{
+	// Otherwise the requests wait for the next step
+	if (!planner.can_publish(async_planning))
+		return;
+	PlanningSnapshot& snapshot = planner.get_snapshot();
+	snapshot.clear();
+	snapshot.step = step_count;
+	snapshot.has_chicken = chicken != nullptr;
+	if (snapshot.has_chicken)
+		snapshot.chicken = registry.motions.get(*chicken).position;
+
+	for (uint i = 0; i < registry.obstacles.size(); i++)
+	{
+		const Entity entity = registry.obstacles.entities[i];
+		if (!registry.motions.has(entity))
+			continue;
+		const Motion& motion = registry.motions.get(entity);
+		const vec2 half_size = abs(motion.scale) / 2.f;
+		snapshot.obstacles.push_back({ motion.position, sqrt(dot(half_size, half_size)) + OBSTACLE_CLEARANCE });
+	}
+
+	// Every bug and every eagle that chose the frontier, including the ones coasting
+	auto& agent_registry = registry.aiAgents;
+	for (uint i = 0; i < agent_registry.size(); i++)
+	{
+		const Entity entity = agent_registry.entities[i];
+		if (!registry.motions.has(entity))
+			continue;
+		const vec2 position = registry.motions.get(entity).position;
+		const AGENT_ARCHETYPE archetype = agent_registry.components[i].archetype;
+		if (archetype == AGENT_ARCHETYPE::BUG || archetype == AGENT_ARCHETYPE::SWARM_BUG)
+			snapshot.bugs.push_back(position);
+		else if (registry.utilityDecisions.has(entity) && registry.utilityDecisions.get(entity).option == HOLD_FRONTIER)
+		{
+			snapshot.members.push_back(entity);
+			snapshot.member_positions.push_back(position);
+		}
+	}
+
+	snapshot.path_requests.swap(path_requests);
+	planner.publish(async_planning);
+	stats.snapshot_published = true;
+}
+
+void AISystem::update_safe_spot(AIAgent& agent, vec2 position, const Entity* chicken)
+{
+	// Swarm bugs stay with their flock, agents keep destinations of their own
+	if (agent.archetype != AGENT_ARCHETYPE::BUG || (agent.has_destination && !agent.fleeing))
+		return;
+	const float chicken_distance = chicken != nullptr ? length(registry.motions.get(*chicken).position - position) : FLT_MAX;
+	if (agent.fleeing)
+	{
+		if (length(agent.destination - position) < SAFE_SPOT_REACHED || chicken_distance > BUG_CALM_RANGE)
+			agent.fleeing = agent.has_destination = false;
+		return;
+	}
+	if (chicken_distance > BUG_FLEE_RANGE)
+		return;
+
+	const vec2 lowest = vec2(SAFE_SPOT_MARGIN);
+	const vec2 highest = vec2((float)window_width_px, (float)window_height_px) - SAFE_SPOT_MARGIN;
+	float least_danger = FLT_MAX;
+	for (int k = 0; k < SAFE_SPOT_CANDIDATES; k++)
+	{
+		const float angle = k * 2.f * (float)M_PI / SAFE_SPOT_CANDIDATES;
+		const vec2 spot = clamp(position + SAFE_SPOT_DISTANCE * vec2(cos(angle), sin(angle)), lowest, highest);
+		const float danger = influence.chicken_proximity.sample(spot);
+		if (danger < least_danger)
+		{
+			least_danger = danger;
+			agent.destination = spot;
+		}
+	}
+	agent.fleeing = agent.has_destination = true;
+}
+
+int AISystem::get_lod_tier(vec2 position, const Entity* chicken) const
+{
+	const bool on_screen = position.x >= 0.f && position.y >= 0.f &&
+		position.x <= window_width_px && position.y <= window_height_px;
+	if (!on_screen)
+		return 2;
+	if (chicken != nullptr)
+	{
+		const vec2 d = position - registry.motions.get(*chicken).position;
+		if (dot(d, d) < lod_near_distance * lod_near_distance)
+			return 0;
+	}
+	return 1;
+}
 
 void AISystem::step(float elapsed_ms)
 {
-	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-	// TODO A2: HANDLE BUG AI HERE
-	// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 2
-	// You will likely want to write new functions and need to create
-	// new data structures to implement a more sophisticated Bug AI.
-	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-
-	(void)elapsed_ms; // placeholder to silence unused warning until implemented
-
-	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-	// TODO A2: DRAW DEBUG INFO HERE on AI path
-	// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 2
-	// You will want to use the createLine from world_init.hpp
-	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-}
\ No newline at end of file
+	Clock::time_point phase_start = Clock::now();
+	Clock::time_point step_start = phase_start;
+	stats = AIStats();
+	step_count++;
+
+	update_flow_field();
+	stats.flow_field_us = lap_us(phase_start);
+	apply_plan();
+	stats.planning_us = lap_us(phase_start);
+	update_influence(elapsed_ms);
+	stats.influence_us = lap_us(phase_start);
+
+	// Reassign the level of detail tiers. Agents are updated every lod_periods[tier] steps,
+	// spread over the steps by their id, and coast on their velocity in between.
+	const Entity* chicken = find_chicken();
+	auto& agent_registry = registry.aiAgents;
+	unsigned int group_count[archetype_count * lod_tier_count] = {};
+	for (uint i = 0; i < agent_registry.size(); i++)
+	{
+		Entity entity = agent_registry.entities[i];
+		if (!registry.motions.has(entity))
+			continue;
+		AIAgent& agent = agent_registry.components[i];
+		const int tier = get_lod_tier(registry.motions.get(entity).position, chicken);
+		const unsigned int period = lod_periods[tier];
+		agent.lod_tier = tier;
+		agent.steps_since_update++;
+		agent.ms_since_update += elapsed_ms;
+		agent.due = agent.steps_since_update >= period || (step_count + (unsigned int)entity) % period == 0;
+		stats.agents_per_archetype[(int)agent.archetype]++;
+		stats.agents_per_tier[tier]++;
+		if (agent.due)
+			group_count[(int)agent.archetype * lod_tier_count + tier]++;
+	}
+
+	// Group the agents updated in this step by archetype and tier, every group starts at a
+	// multiple of four
+	group_start[0] = 0;
+	for (int g = 0; g < archetype_count * lod_tier_count; g++)
+		group_start[g + 1] = group_start[g] + (group_count[g] + 3) / 4 * 4;
+	for (int k = 0; k <= archetype_count; k++)
+		archetype_start[k] = group_start[k * lod_tier_count];
+	const size_t slot_count = archetype_start[archetype_count];
+
+	batch.resize(slot_count);
+	// Growing it again after shrinking would take new ids for the default entities
+	if (batch_entities.size() < slot_count)
+		batch_entities.resize(slot_count);
+	batch_used.assign(slot_count, 0);
+	batch_elapsed_ms.assign(slot_count, 0.f);
+	batch_steer_ms.assign(slot_count, 0.f);
+	size_t fill[archetype_count * lod_tier_count];
+	for (int g = 0; g < archetype_count * lod_tier_count; g++)
+		fill[g] = group_start[g];
+	for (uint i = 0; i < agent_registry.size(); i++)
+	{
+		const Entity entity = agent_registry.entities[i];
+		AIAgent& agent = agent_registry.components[i];
+		if (!registry.motions.has(entity) || !agent.due)
+			continue;
+		const AGENT_ARCHETYPE archetype = agent.archetype;
+		const size_t slot = fill[(int)archetype * lod_tier_count + agent.lod_tier]++;
+		const Motion& motion = registry.motions.get(entity);
+		batch_entities[slot] = entity;
+		batch_used[slot] = 1;
+		batch_elapsed_ms[slot] = agent.ms_since_update;
+		// An agent that just changed tiers can be due early, it only gets the time it coasted
+		batch_steer_ms[slot] = min(agent.ms_since_update, elapsed_ms * lod_periods[agent.lod_tier]);
+		agent.steps_since_update = 0;
+		agent.ms_since_update = 0.f;
+		stats.updated_per_tier[agent.lod_tier]++;
+		batch.position_x[slot] = motion.position.x;
+		batch.position_y[slot] = motion.position.y;
+		batch.velocity_x[slot] = motion.velocity.x;
+		batch.velocity_y[slot] = motion.velocity.y;
+		find_target_and_threat(slot, archetype);
+		update_safe_spot(agent, motion.position, chicken);
+		if (!agent.has_destination && registry.aiPaths.has(entity))
+			registry.aiPaths.remove(entity);
+		vec2 flow = { 0, 0 };
+		if (agent.has_destination)
+			flow = follow_path(entity, agent, motion.position);
+		else if (archetype == AGENT_ARCHETYPE::BUG || archetype == AGENT_ARCHETYPE::SWARM_BUG)
+			flow = downhill(influence.chicken_proximity, motion.position);
+		else
+			flow = chicken_flow.get_direction(motion.position);
+		batch.flow_x[slot] = flow.x;
+		batch.flow_y[slot] = flow.y;
+	}
+	for (int k = 0; k < archetype_count; k++)
+		stats.agents += stats.agents_per_archetype[k];
+	stats.gather_us = lap_us(phase_start);
+
+	update_decisions(elapsed_ms);
+	stats.utility_us = lap_us(phase_start);
+
+	// Agents of the same archetype share their tree, tick them together
+	for (int k = 0; k < archetype_count; k++)
+	{
+		const BehaviorTree& tree = behavior_trees[k];
+		if (tree.empty())
+			continue;
+		for (size_t slot = archetype_start[k]; slot < archetype_start[k + 1]; slot++)
+		{
+			if (!batch_used[slot])
+				continue;
+			const Entity entity = batch_entities[slot];
+			Blackboard& blackboard = registry.blackboards.has(entity) ? registry.blackboards.get(entity) : registry.blackboards.emplace(entity);
+			vec2 slot_position;
+			blackboard.in_formation = !stats.plan_stale && plan.get_slot(entity, slot_position);
+			if (blackboard.in_formation)
+			{
+				batch.target_x[slot] = slot_position.x;
+				batch.target_y[slot] = slot_position.y;
+				batch.target_velocity_x[slot] = 0.f;
+				batch.target_velocity_y[slot] = 0.f;
+				batch.target_weight[slot] = 1.f;
+			}
+			BTContext context = { entity, blackboard, batch, slot, batch_elapsed_ms[slot] };
+			tree.tick(context);
+			batch.target_weight[slot] *= blackboard.target_weight;
+			batch.threat_weight[slot] *= blackboard.threat_weight;
+			batch.flow_x[slot] *= blackboard.flow_weight;
+			batch.flow_y[slot] *= blackboard.flow_weight;
+		}
+	}
+	stats.behavior_us = lap_us(phase_start);
+
+	// Separation looks at the agents of all archetypes updated in this step, flocking at the
+	// ones of the same archetype
+	float cell_size = 1.f;
+	for (const SteeringArchetype& archetype : archetypes)
+		cell_size = max(cell_size, archetype.flocks() ? max(archetype.separation_radius, archetype.neighbor_radius) : archetype.separation_radius);
+	neighbor_grid.build(batch.position_x.data(), batch.position_y.data(), (unsigned int)slot_count, cell_size, batch_used.data());
+
+	// Flocking reads the velocities of the neighbors, all of them are computed before any
+	// agent is steered
+	jobs.parallel_for(slot_count / 4, STEERING_GRAIN / 4, [&](size_t begin, size_t end) {
+		for (int k = 0; k < archetype_count; k++)
+		{
+			const size_t first = max(4 * begin, archetype_start[k]);
+			const size_t last = min(4 * end, archetype_start[k + 1]);
+			if (first >= last)
+				continue;
+			const SteeringArchetype& archetype = archetypes[k];
+			if (archetype.flocks())
+				compute_flocking(batch, neighbor_grid, archetype, first, last, archetype_start[k], archetype_start[k + 1]);
+			else
+				compute_separation(batch, neighbor_grid, archetype.separation_radius, first, last);
+		}
+	});
+
+	// The acceleration of every agent is limited over the time since its last update
+	jobs.parallel_for(slot_count / 4, STEERING_GRAIN / 4, [&](size_t begin, size_t end) {
+		for (int k = 0; k < archetype_count; k++)
+		{
+			const size_t first = max(4 * begin, archetype_start[k]);
+			const size_t last = min(4 * end, archetype_start[k + 1]);
+			if (first < last)
+				steer(archetypes[k], batch, first, last, batch_steer_ms.data());
+		}
+	});
+
+	for (size_t slot = 0; slot < slot_count; slot++)
+	{
+		if (!batch_used[slot])
+			continue;
+		Motion& motion = registry.motions.get(batch_entities[slot]);
+		motion.velocity = { batch.velocity_x[slot], batch.velocity_y[slot] };
+	}
+	stats.steering_us = lap_us(phase_start);
+	publish_snapshot(chicken);
+	stats.planning_us += lap_us(phase_start);
+	stats.total_us = lap_us(step_start);
+
+	// Where every agent is heading in the next half second, colored by tier, and the flow field
+	if (debugging.in_debug_mode)
+	{
+		const vec3 flow_color = { 0.3f, 0.3f, 0.8f };
+		const int cell_count = chicken_flow.get_dims().x * chicken_flow.get_dims().y;
+		for (int cell = 0; cell < cell_count && chicken_flow.has_goal(); cell++)
+		{
+			const vec2 center = chicken_flow.get_cell_center(cell);
+			debug_draw_line(center, center + 0.4f * chicken_flow.get_cell_size() * chicken_flow.get_direction(center), flow_color);
+		}
+
+		const vec3 frontier_color = { 0.9f, 0.2f, 0.6f };
+		const std::vector<vec2>& front = plan.front;
+		for (size_t k = 0; k + 1 < front.size(); k++)
+			debug_draw_line(front[k], front[k + 1], frontier_color);
+		for (vec2 slot_position : plan.slots)
+		{
+			debug_draw_line(slot_position - vec2(8.f, 0.f), slot_position + vec2(8.f, 0.f), frontier_color);
+			debug_draw_line(slot_position - vec2(0.f, 8.f), slot_position + vec2(0.f, 8.f), frontier_color);
+		}
+
+		const vec3 path_color = { 0.8f, 0.6f, 0.1f };
+		for (const AIPath& path : registry.aiPaths.components)
+			for (size_t k = path.next; k + 1 < path.waypoints.size(); k++)
+				debug_draw_line(path.waypoints[k], path.waypoints[k + 1], path_color);
+
+		const vec3 tier_colors[lod_tier_count] = { { 0.1f, 0.7f, 0.2f }, { 0.7f, 0.7f, 0.1f }, { 0.7f, 0.2f, 0.1f } };
+		for (uint i = 0; i < agent_registry.size(); i++)
+		{
+			const Entity entity = agent_registry.entities[i];
+			if (!registry.motions.has(entity))
+				continue;
+			const Motion& motion = registry.motions.get(entity);
+			debug_draw_line(motion.position, motion.position + 0.5f * motion.velocity, tier_colors[agent_registry.components[i].lod_tier]);
+		}
+	}
+}
@@ -4,13 +4,149 @@
 
 #include "tiny_ecs_registry.hpp"
 #include "common.hpp"
+#include "behavior_tree.hpp"
+#include "flow_field.hpp"
+#include "influence_map.hpp"
+#include "job_system.hpp"
+#include "neighbor_grid.hpp"
+#include "planner.hpp"
+#include "steering.hpp"
+#include "utility_ai.hpp"
 
-// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-// DON'T WORRY ABOUT THIS CLASS UNTIL ASSIGNMENT 3
-// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+class PhysicsSystem;
 
+// AI level of detail: near the chicken on screen, elsewhere on screen, off screen
+const int lod_tier_count = 3;
+
+// Counters and timings of the last AISystem::step, times are in microseconds
+struct AIStats
+{
+	unsigned int agents = 0;
+	unsigned int agents_per_archetype[archetype_count] = {};
+	unsigned int agents_per_tier[lod_tier_count] = {};
+	unsigned int updated_per_tier[lod_tier_count] = {}; // agents updated in this step
+	bool flow_field_rebuilt = false;
+	float flow_field_us = 0.f;
+	unsigned int paths_requested = 0;
+	unsigned int paths_planned = 0; // received from the planner and applied
+	bool snapshot_published = false;
+	unsigned int plan_age = 0; // steps since the snapshot of the plan in use was taken
+	bool plan_stale = false; // older than max_plan_age and not used
+	float plan_us = 0.f; // planning the plan in use on the worker, not part of the step
+	float planning_us = 0.f; // taking the plan, applying its paths and filling the snapshot
+	float influence_us = 0.f; // decaying and splatting the influence maps
+	float gather_us = 0.f; // targets, threats and the structure of arrays copy
+	unsigned int decisions_evaluated = 0;
+	unsigned int decisions_reused = 0;
+	float oldest_decision_ms = 0.f;
+	float utility_us = 0.f; // evaluating and applying the decisions
+	float behavior_us = 0.f; // behavior trees
+	float steering_us = 0.f; // neighbor grid, separation and flocking, and the steering pass
+	float total_us = 0.f;
+};
+
+// Steers every AIAgent with the behaviors and weights of its archetype. Agents are put in
+// a level of detail tier every step and only updated every lod_periods[tier] steps, the
+// others coast. Each step copies the agents to update into a SteeringBatch grouped by
+// archetype and tier, looks up targets and threats in the spatial index of the physics
+// system and the direction towards the chicken in a shared flow field (or along the path
+// to their own destination, bugs drift away from the chicken on its influence map).
+// Archetypes with a utility reasoner pick their target with it instead, a few agents per
+// step within a time budget, in turns, scoring places on the influence maps. Eagles that
+// chose to hold the frontier get a slot of the formation between the chicken and the bugs
+// as their target. The behavior tree of the archetype then decides per agent how much of
+// each it follows, the agents of an archetype are ticked one after the other. Finally all
+// agents are evaluated in one pass that works on four agents at a time, split over the job
+// system. The results are written to Motion::velocity.
+//
+// Paths and the formation are planned by the Planner on a worker thread. At the end of a
+// step the AISystem copies what they need into a snapshot, at the start of the next ones it
+// applies the newest plan. Plans older than max_plan_age steps are dropped, the eagles then
+// fall back to their own target and the paths are requested again. Until its path arrives,
+// or if there is none, an agent heads straight for its destination. Plain bugs that the
+// chicken comes close to get a destination, the spot around them it was least near lately.
 class AISystem
 {
 public:
+	AISystem(JobSystem& jobs = get_job_system());
+
+	// Targets and threats are looked up among the bodies of the last physics step
+	void init(PhysicsSystem* physics);
+
 	void step(float elapsed_ms);
-};
\ No newline at end of file
+
+	const AIStats& get_stats() const { return stats; }
+
+	// Tuning of every archetype, indexed by AGENT_ARCHETYPE
+	SteeringArchetype archetypes[archetype_count];
+	// Decisions of every archetype, agents of archetypes with an empty tree follow everything
+	BehaviorTree behavior_trees[archetype_count];
+	// Target selection of every archetype, the nearest target on its layers if empty
+	UtilityReasoner reasoners[archetype_count];
+	// Time per step for re-evaluating utility decisions, at least one agent is evaluated
+	float utility_budget_us = 200.f;
+	// Steps between updates of the agents of every level of detail tier
+	unsigned int lod_periods[lod_tier_count] = { 1, 4, 16 };
+	// Agents on screen this close to the chicken are in the first tier
+	float lod_near_distance = 400.f;
+	// Plan on the worker of the planner, or on the calling thread at the end of the step
+	bool async_planning = true;
+	// Steps after its snapshot a plan is used for at most
+	unsigned int max_plan_age = 15;
+
+	// Paths to the chicken around the Obstacle entities
+	const FlowField& get_chicken_flow() const { return chicken_flow; }
+	// Where the eagles, bugs and the chicken are and were lately
+	const InfluenceMaps& get_influence() const { return influence; }
+	// Newest paths and slots between the chicken and the bugs for the eagles holding the frontier
+	const PlanningResult& get_plan() const { return plan; }
+
+private:
+	// Moves the goal of the chicken flow field and restamps the obstacles
+	void update_flow_field();
+	void update_influence(float elapsed_ms);
+	// Takes the newest plan of the planner and applies its paths
+	void apply_plan();
+	// Copies the world and the path requests for the planner, if it can take them
+	void publish_snapshot(const Entity* chicken);
+
+	// Unit direction along the path of an agent with a destination, requests a new one when
+	// the destination or the obstacles changed
+	vec2 follow_path(Entity entity, const AIAgent& agent, vec2 position);
+
+	// Sends plain bugs near the chicken to a safe spot and calls them off once there
+	void update_safe_spot(AIAgent& agent, vec2 position, const Entity* chicken);
+
+	// Fills the target and threat of agent 'i' from the nearest body on the layers
+	void find_target_and_threat(size_t i, AGENT_ARCHETYPE archetype);
+
+	// Re-evaluates the decisions of the next agents in turn until the budget is used up and
+	// makes the targets of all agents with a decision follow it
+	void update_decisions(float elapsed_ms);
+
+	int get_lod_tier(vec2 position, const Entity* chicken) const;
+
+	JobSystem& jobs;
+	PhysicsSystem* physics = nullptr;
+	AIStats stats;
+	FlowField chicken_flow;
+	InfluenceMaps influence;
+	Planner planner;
+	PlanningResult plan;
+	std::vector<PathRequest> path_requests; // for the next snapshot
+	Entity nearest; // result of the spatial index queries, reused since Entity() takes a new id
+
+	SteeringBatch batch;
+	NeighborGrid neighbor_grid;
+	std::vector<Entity> batch_entities; // agent of every batch slot, stale for padding
+	std::vector<char> batch_used; // 0 for padding
+	std::vector<float> batch_elapsed_ms; // since the last update of the agent
+	std::vector<float> batch_steer_ms; // the same, at most the period of its tier
+	size_t group_start[archetype_count * lod_tier_count + 1]; // of every archetype and tier
+	size_t archetype_start[archetype_count + 1];
+	unsigned int step_count = 0;
+	std::vector<Entity> decision_agents; // with a reasoner
+	std::vector<Entity> urgent_agents; // without a valid decision
+	size_t decision_cursor = 0; // next in decision_agents to be evaluated
+	std::vector<float> option_shares[archetype_count];
+};
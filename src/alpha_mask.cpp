@@ -0,0 +1,137 @@
+// internal
+#include "alpha_mask.hpp"
+
+// stlib
+#include <algorithm>
+#include <cfloat>
+
+void BitMask::resize(int width_arg, int height_arg)
+{
+	width = width_arg;
+	height = height_arg;
+	words_per_row = (width + 63) / 64 + 1;
+	words.assign((size_t)words_per_row * height, 0);
+}
+
+void BitMask::set_span(int y, int x_begin, int x_end)
+{
+	uint64_t* row = words.data() + (size_t)y * words_per_row;
+	while (x_begin < x_end)
+	{
+		const int shift = x_begin & 63;
+		const int count = min(64 - shift, x_end - x_begin);
+		const uint64_t bits = count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1);
+		row[x_begin >> 6] |= bits << shift;
+		x_begin += count;
+	}
+}
+
+uint64_t BitMask::get_bits(int x, int y) const
+{
+	const uint64_t* row = words.data() + (size_t)y * words_per_row + (x >> 6);
+	const int shift = x & 63;
+	if (shift == 0)
+		return row[0];
+	return (row[0] >> shift) | (row[1] << (64 - shift));
+}
+
+void BitMask::fill_triangle(vec2 a, vec2 b, vec2 c)
+{
+	const vec2 corners[3] = { a, b, c };
+	const int y_begin = max(0, (int)ceil(min(a.y, min(b.y, c.y)) - 0.5f));
+	const int y_end = min(height, (int)floor(max(a.y, max(b.y, c.y)) - 0.5f) + 1);
+	for (int y = y_begin; y < y_end; y++)
+	{
+		// where the row through the pixel centers enters and leaves the triangle
+		const float center_y = y + 0.5f;
+		float x_min = FLT_MAX, x_max = -FLT_MAX;
+		for (int k = 0; k < 3; k++)
+		{
+			const vec2 p = corners[k];
+			const vec2 q = corners[(k + 1) % 3];
+			if ((p.y <= center_y) == (q.y <= center_y))
+				continue;
+			const float x = p.x + (center_y - p.y) * (q.x - p.x) / (q.y - p.y);
+			x_min = min(x_min, x);
+			x_max = max(x_max, x);
+		}
+		if (x_min > x_max)
+			continue;
+		const int x_begin = max(0, (int)ceil(x_min - 0.5f));
+		const int x_end = min(width, (int)floor(x_max - 0.5f) + 1);
+		if (x_begin < x_end)
+			set_span(y, x_begin, x_end);
+	}
+}
+
+bool bit_masks_overlap(const BitMask& a, ivec2 a_offset, const BitMask& b, ivec2 b_offset)
+{
+	// overlapping rectangle in the shared grid
+	const int x_begin = max(a_offset.x, b_offset.x);
+	const int x_end = min(a_offset.x + a.width, b_offset.x + b.width);
+	const int y_begin = max(a_offset.y, b_offset.y);
+	const int y_end = min(a_offset.y + a.height, b_offset.y + b.height);
+	for (int y = y_begin; y < y_end; y++)
+	{
+		for (int x = x_begin; x < x_end; x += 64)
+		{
+			uint64_t bits = a.get_bits(x - a_offset.x, y - a_offset.y) & b.get_bits(x - b_offset.x, y - b_offset.y);
+			// the last word of a row may reach past the overlap
+			if (x_end - x < 64)
+				bits &= (uint64_t(1) << (x_end - x)) - 1;
+			if (bits != 0)
+				return true;
+		}
+	}
+	return false;
+}
+
+void AlphaMask::build(const unsigned char* rgba, int width, int height, unsigned char alpha_threshold)
+{
+	levels.clear();
+	levels.emplace_back();
+	BitMask& base = levels.back();
+	base.resize(width, height);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			if (rgba[4 * ((size_t)y * width + x) + 3] >= alpha_threshold)
+				base.set(x, y);
+
+	while (levels.back().width > 1 || levels.back().height > 1)
+	{
+		BitMask coarse;
+		{
+			const BitMask& fine = levels.back();
+			coarse.resize((fine.width + 1) / 2, (fine.height + 1) / 2);
+			for (int y = 0; y < fine.height; y++)
+				for (int x = 0; x < fine.width; x++)
+					if (fine.get(x, y))
+						coarse.set(x / 2, y / 2);
+		}
+		levels.push_back(std::move(coarse));
+	}
+}
+
+void AlphaMask::resample(int width, int height, bool flip_x, bool flip_y, BitMask& out) const
+{
+	out.resize(width, height);
+	if (levels.empty())
+		return;
+	int level = 0;
+	while (level + 1 < (int)levels.size() && levels[level + 1].width >= width && levels[level + 1].height >= height)
+		level++;
+	const BitMask& source = levels[level];
+
+	const float step_x = (float)source.width / width;
+	const float step_y = (float)source.height / height;
+	for (int y = 0; y < height; y++)
+	{
+		const int source_y = min(source.height - 1, (int)(((flip_y ? height - 1 - y : y) + 0.5f) * step_y));
+		for (int x = 0; x < width; x++)
+		{
+			const int source_x = min(source.width - 1, (int)(((flip_x ? width - 1 - x : x) + 0.5f) * step_x));
+			if (source.get(source_x, source_y))
+				out.set(x, y);
+		}
+	}
+}
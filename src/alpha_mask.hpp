@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "common.hpp"
+
+// One bit per pixel, stored in rows of 64 bit words. Pixel x of a row is bit x % 64 of
+// word x / 64, every row ends with a spare zero word so that 64 pixels can be read
+// starting at any x of the row.
+struct BitMask
+{
+	int width = 0;
+	int height = 0;
+	int words_per_row = 0;
+	std::vector<uint64_t> words;
+
+	// Resizes to width x height pixels, all cleared
+	void resize(int width, int height);
+	bool empty() const { return width == 0 || height == 0; }
+
+	bool get(int x, int y) const { return (words[y * words_per_row + (x >> 6)] >> (x & 63)) & 1u; }
+	void set(int x, int y) { words[y * words_per_row + (x >> 6)] |= uint64_t(1) << (x & 63); }
+	// Sets the pixels [x_begin, x_end) of row y
+	void set_span(int y, int x_begin, int x_end);
+	// The 64 pixels of row y starting at x in the low to high bits, 0 past the end of the row
+	uint64_t get_bits(int x, int y) const;
+
+	// Sets the pixels whose centers lie inside the triangle given in pixel coordinates
+	void fill_triangle(vec2 a, vec2 b, vec2 c);
+};
+
+// Returns true if a pixel is set in both masks. The offsets place the top left pixel of each
+// mask in a shared pixel grid, the overlapping rows are compared 64 pixels at a time.
+bool bit_masks_overlap(const BitMask& a, ivec2 a_offset, const BitMask& b, ivec2 b_offset);
+
+// Opaque pixels of a texture, built once when the texture is loaded. Level 0 has one bit
+// per texel, every further level halves the resolution and sets a bit if any of the 2x2
+// bits below it is set, so that coarser levels never lose an opaque pixel.
+class AlphaMask
+{
+public:
+	// 'rgba' holds width x height texels of four bytes, the first row is the top of the image
+	void build(const unsigned char* rgba, int width, int height, unsigned char alpha_threshold = 128);
+
+	// Scales the mask to width x height pixels by nearest neighbour from the coarsest level
+	// that is still at least that large, mirrored along x and/or y if requested
+	void resample(int width, int height, bool flip_x, bool flip_y, BitMask& out) const;
+
+	bool empty() const { return levels.empty(); }
+	int get_level_count() const { return (int)levels.size(); }
+	const BitMask& get_level(int level) const { return levels[level]; }
+
+private:
+	std::vector<BitMask> levels;
+};
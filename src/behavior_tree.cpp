@@ -0,0 +1,116 @@
+// internal
+#include "behavior_tree.hpp"
+#include "components.hpp"
+
+// stlib
+#include <cassert>
+
+void BehaviorTree::begin(BT_NODE type)
+{
+	assert(type == BT_NODE::SEQUENCE || type == BT_NODE::SELECTOR || type == BT_NODE::INVERTER);
+	assert(nodes.empty() || !open.empty()); // a single root
+	open.push_back((int)nodes.size());
+	nodes.push_back({ type, open.size() > 1 ? open[open.size() - 2] : -1, -1, nullptr });
+}
+
+void BehaviorTree::add(BT_NODE type, BTLeaf leaf)
+{
+	assert((type == BT_NODE::CONDITION || type == BT_NODE::ACTION) && leaf != nullptr);
+	assert(nodes.empty() || !open.empty());
+	const int index = (int)nodes.size();
+	nodes.push_back({ type, open.empty() ? -1 : open.back(), index + 1, leaf });
+}
+
+void BehaviorTree::end()
+{
+	assert(!open.empty());
+	BTNode& node = nodes[open.back()];
+	node.end = (int)nodes.size();
+	assert(node.type != BT_NODE::INVERTER || node.end - open.back() > 1);
+	open.pop_back();
+}
+
+static BT_STATUS invert(BT_STATUS status)
+{
+	if (status == BT_STATUS::SUCCESS)
+		return BT_STATUS::FAILURE;
+	if (status == BT_STATUS::FAILURE)
+		return BT_STATUS::SUCCESS;
+	return status;
+}
+
+BT_STATUS BehaviorTree::enter(int index, BTContext& context) const
+{
+	const BTNode& node = nodes[index];
+	switch (node.type)
+	{
+	case BT_NODE::SEQUENCE:
+	case BT_NODE::SELECTOR:
+	{
+		// a sequence stops at the first child that doesn't succeed, a selector at the
+		// first that doesn't fail
+		const BT_STATUS go_on = node.type == BT_NODE::SEQUENCE ? BT_STATUS::SUCCESS : BT_STATUS::FAILURE;
+		for (int child = index + 1; child < node.end; child = nodes[child].end)
+		{
+			const BT_STATUS status = enter(child, context);
+			if (status != go_on)
+				return status;
+		}
+		return go_on;
+	}
+	case BT_NODE::INVERTER:
+		return invert(enter(index + 1, context));
+	default:
+	{
+		if (node.type == BT_NODE::ACTION)
+			context.blackboard.running_ms = 0.f;
+		const BT_STATUS status = node.leaf(context);
+		if (status == BT_STATUS::RUNNING)
+			context.blackboard.running_node = index;
+		return status;
+	}
+	}
+}
+
+BT_STATUS BehaviorTree::tick(BTContext& context) const
+{
+	if (nodes.empty())
+		return BT_STATUS::FAILURE;
+
+	Blackboard& blackboard = context.blackboard;
+	int index = blackboard.running_node;
+	blackboard.running_node = -1;
+	BT_STATUS status;
+	if (index >= 0 && index < (int)nodes.size() && nodes[index].type == BT_NODE::ACTION)
+	{
+		blackboard.running_ms += context.elapsed_ms;
+		status = nodes[index].leaf(context);
+		if (status == BT_STATUS::RUNNING)
+			blackboard.running_node = index;
+	}
+	else
+	{
+		index = 0;
+		status = enter(index, context);
+	}
+
+	// Continue in the ancestors of a resumed action as if it had finished in this tick
+	while (status != BT_STATUS::RUNNING && nodes[index].parent >= 0)
+	{
+		const int parent = nodes[index].parent;
+		const BTNode& node = nodes[parent];
+		const int next = nodes[index].end;
+		const bool sequence_goes_on = node.type == BT_NODE::SEQUENCE && status == BT_STATUS::SUCCESS;
+		const bool selector_goes_on = node.type == BT_NODE::SELECTOR && status == BT_STATUS::FAILURE;
+		if ((sequence_goes_on || selector_goes_on) && next < node.end)
+		{
+			index = next;
+			status = enter(index, context);
+			continue;
+		}
+		if (node.type == BT_NODE::INVERTER)
+			status = invert(status);
+		index = parent;
+	}
+	return status;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "tiny_ecs.hpp"
+
+struct Blackboard;
+struct SteeringBatch;
+
+enum class BT_STATUS {
+	SUCCESS = 0,
+	FAILURE = SUCCESS + 1,
+	RUNNING = FAILURE + 1
+};
+
+enum class BT_NODE {
+	SEQUENCE = 0, // runs the children in order until one doesn't succeed
+	SELECTOR = SEQUENCE + 1, // runs the children in order until one doesn't fail
+	INVERTER = SELECTOR + 1, // swaps the success and failure of its single child
+	CONDITION = INVERTER + 1, // leaf that succeeds or fails
+	ACTION = CONDITION + 1 // leaf that may keep running over several ticks
+};
+
+// What a leaf sees of the agent it is evaluated for
+struct BTContext
+{
+	Entity entity;
+	Blackboard& blackboard;
+	const SteeringBatch& batch; // with the gathered targets and threats
+	size_t slot; // of the agent in the batch
+	float elapsed_ms;
+};
+
+typedef BT_STATUS (*BTLeaf)(BTContext& context);
+
+// A node of a flattened tree. The nodes are stored in depth first order, so the children
+// of a node follow it and its subtree ends at 'end'.
+struct BTNode
+{
+	BT_NODE type;
+	int parent; // -1 for the root
+	int end; // one past the last node of the subtree
+	BTLeaf leaf; // conditions and actions only
+};
+
+// Behavior tree flattened into one array of nodes, shared by all agents running it. The
+// per-agent state lives in their Blackboard. An action that returns RUNNING is resumed
+// directly on the next tick, the conditions and composites before it are not evaluated
+// again until it finishes, so actions have to fail by themselves when they become
+// pointless. Blackboard::running_ms tells an action how long it has been running.
+// Build the tree with begin() and end() around the children of composites:
+//
+//   tree.begin(BT_NODE::SELECTOR);
+//     tree.begin(BT_NODE::SEQUENCE);
+//       tree.add(BT_NODE::CONDITION, is_hungry);
+//       tree.add(BT_NODE::ACTION, eat);
+//     tree.end();
+//     tree.add(BT_NODE::ACTION, wander);
+//   tree.end();
+class BehaviorTree
+{
+public:
+	void begin(BT_NODE type);
+	void add(BT_NODE type, BTLeaf leaf);
+	void end();
+
+	bool empty() const { return nodes.empty(); }
+	const std::vector<BTNode>& get_nodes() const { return nodes; }
+
+	// Runs the tree for one agent, from the running action of its blackboard if there is one
+	BT_STATUS tick(BTContext& context) const;
+
+private:
+	// Evaluates the subtree of 'node' from its first child
+	BT_STATUS enter(int node, BTContext& context) const;
+
+	std::vector<BTNode> nodes;
+	std::vector<int> open; // composites begun but not ended
+};
@@ -0,0 +1,799 @@
+// internal
+#include "benchmarks.hpp"
+#include "ai_system.hpp"
+#include "physics_system.hpp"
+#include "fixed_point.hpp"
+#include "formation.hpp"
+#include "influence_map.hpp"
+#include "pathfinder.hpp"
+#include "rigid_body_solver.hpp"
+#include "simd.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "wind_system.hpp"
+#include "world_init.hpp"
+
+// stlib
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+	// Microseconds since 'start'
+	float elapsed_us(Clock::time_point start)
+	{
+		return (float)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count() / 1000.f;
+	}
+
+	// Order dependent hash of the bit patterns of all positions, equal hashes across two
+	// builds mean bit-identical trajectories
+	uint32_t hash_positions(const std::vector<Motion>& motions)
+	{
+		uint32_t hash = 2166136261u;
+		for (const Motion& motion : motions)
+		{
+			uint32_t bits[2];
+			memcpy(bits, &motion.position, sizeof(bits));
+			hash = (hash ^ bits[0]) * 16777619u;
+			hash = (hash ^ bits[1]) * 16777619u;
+		}
+		return hash;
+	}
+
+	// Bodies with random position, velocity and size spread over the play area
+	std::vector<Motion> random_motions(size_t count)
+	{
+		std::default_random_engine rng(427);
+		std::uniform_real_distribution<float> uniform_dist; // number between 0..1
+		std::vector<Motion> motions(count);
+		for (Motion& motion : motions)
+		{
+			motion.position = { uniform_dist(rng) * window_width_px, uniform_dist(rng) * window_height_px };
+			motion.velocity = { (uniform_dist(rng) - 0.5f) * 400.f, (uniform_dist(rng) - 0.5f) * 400.f };
+			motion.scale = vec2(20.f + uniform_dist(rng) * 60.f);
+		}
+		return motions;
+	}
+
+	// Float vs. Q24.8 fixed point motion integration and bounding circle tests
+	void benchmark_fixed_point()
+	{
+		const size_t body_count = 10000;
+		const int tick_count = 600;
+		const float tick_ms = 1000.f / 60.f;
+
+		std::vector<Motion> float_motions = random_motions(body_count);
+		Clock::time_point start = Clock::now();
+		for (int tick = 0; tick < tick_count; tick++)
+			for (Motion& motion : float_motions)
+				motion.position += (tick_ms / 1000.f) * motion.velocity;
+		float float_us = elapsed_us(start);
+
+		std::vector<Motion> fixed_motions = random_motions(body_count);
+		start = Clock::now();
+		for (int tick = 0; tick < tick_count; tick++)
+			for (Motion& motion : fixed_motions)
+				motion.position = fixed_point::integrate(motion.position, motion.velocity, tick_ms);
+		float fixed_us = elapsed_us(start);
+
+		printf("integrate %zu bodies x %d ticks\n", body_count, tick_count);
+		printf("  float: %8.2f ns/body  hash %08x\n", 1000.f * float_us / (body_count * tick_count), hash_positions(float_motions));
+		printf("  fixed: %8.2f ns/body  hash %08x\n", 1000.f * fixed_us / (body_count * tick_count), hash_positions(fixed_motions));
+
+		// all pairs of a smaller set
+		const std::vector<Motion> motions = random_motions(2000);
+		size_t pair_count = motions.size() * (motions.size() - 1) / 2;
+		size_t float_hits = 0, fixed_hits = 0;
+		start = Clock::now();
+		for (size_t i = 0; i < motions.size(); i++)
+			for (size_t j = i + 1; j < motions.size(); j++)
+				float_hits += collides_float(motions[i], motions[j]);
+		float_us = elapsed_us(start);
+		start = Clock::now();
+		for (size_t i = 0; i < motions.size(); i++)
+			for (size_t j = i + 1; j < motions.size(); j++)
+				fixed_hits += collides_fixed(motions[i], motions[j]);
+		fixed_us = elapsed_us(start);
+
+		printf("collides %zu pairs\n", pair_count);
+		printf("  float: %8.2f ns/pair  %zu hits\n", 1000.f * float_us / pair_count, float_hits);
+		printf("  fixed: %8.2f ns/pair  %zu hits\n", 1000.f * fixed_us / pair_count, fixed_hits);
+	}
+
+	// Runs the egg scene on 'thread_count' threads and returns the hash of the final positions
+	uint32_t run_rigid_body_scene(unsigned int thread_count)
+	{
+		const float egg_radius = 4.f;
+		const int cluster_count = 3334; // of three eggs each
+		const float pitch = 4.f * egg_radius + 8.f;
+		const int tick_count = 240;
+		const float tick_ms = 1000.f / 60.f;
+
+		// Small stacks of two eggs with one on top side by side on a long floor, separated
+		// by gaps so that every stack is one island. The top egg lands on the others, the
+		// stacks settle and fall asleep.
+		JobSystem jobs(thread_count);
+		RigidBodySolver solver(jobs);
+		solver.set_bounds({ 0.f, -64.f }, { cluster_count * pitch, 0.f }, 16.f);
+		for (int c = 0; c < cluster_count; c++)
+		{
+			const float x = c * pitch + egg_radius;
+			createEgg({ x, -egg_radius }, vec2(2.f * egg_radius));
+			createEgg({ x + 2.f * egg_radius, -egg_radius }, vec2(2.f * egg_radius));
+			createEgg({ x + egg_radius, -4.f * egg_radius }, vec2(2.f * egg_radius));
+		}
+
+		// Settling, then resting
+		float settle_us = 0.f, rest_us = 0.f, rest_max_us = 0.f;
+		for (int tick = 0; tick < tick_count; tick++)
+		{
+			const Clock::time_point start = Clock::now();
+			solver.step(tick_ms);
+			const float us = elapsed_us(start);
+			if (tick < tick_count / 2)
+				settle_us += us;
+			else
+			{
+				rest_us += us;
+				rest_max_us = max(rest_max_us, us);
+			}
+		}
+		const RigidBodyStats& stats = solver.get_stats();
+		printf("  %2u threads: settling %7.1f us/step, resting %7.1f us/step (max %7.1f), %u bodies, %u awake, %u islands\n",
+			jobs.get_thread_count(), settle_us / (tick_count / 2), rest_us / (tick_count / 2), rest_max_us,
+			stats.bodies, stats.awake_bodies, stats.islands);
+
+		std::vector<Motion> motions = registry.motions.components;
+		registry.clear_all_components();
+		return hash_positions(motions);
+	}
+
+	// 10k eggs settling in small stacks and resting on the floor
+	void benchmark_rigid_bodies()
+	{
+		const uint32_t single_hash = run_rigid_body_scene(1);
+		const uint32_t pool_hash = run_rigid_body_scene(0);
+		printf("  positions %s across thread counts (%08x, %08x)\n",
+			single_hash == pool_hash ? "identical" : "DIFFER", single_hash, pool_hash);
+	}
+
+	// Runs the wind grid with a few blowers on 'thread_count' threads, returns the wind
+	// at a fixed point as a check that the results match
+	vec2 run_wind_scene(int width, int height, unsigned int thread_count)
+	{
+		const int tick_count = 300;
+		const float tick_ms = 1000.f / 60.f;
+		JobSystem jobs(thread_count);
+		WindSystem wind(width, height, jobs);
+		const vec2 window = { (float)window_width_px, (float)window_height_px };
+		const vec2 blowers[] = { window * vec2(0.3f, 0.3f), window * vec2(0.7f, 0.5f), window * vec2(0.4f, 0.8f) };
+
+		float total_us = 0.f, max_us = 0.f;
+		for (int tick = 0; tick < tick_count; tick++)
+		{
+			const Clock::time_point start = Clock::now();
+			for (const vec2& blower : blowers)
+				wind.add_blower(blower, 135.f, tick_ms);
+			wind.simulate(tick_ms);
+			const float us = elapsed_us(start);
+			total_us += us;
+			max_us = max(max_us, us);
+		}
+		printf("  %3dx%3d cells, %2u threads: %8.1f us/step (max %8.1f), %d pressure iterations\n",
+			width, height, jobs.get_thread_count(), total_us / tick_count, max_us, wind.pressure_iterations);
+		return wind.sample(window * vec2(0.5f, 0.5f));
+	}
+
+	// The default grid and the largest one that has to fit into a 60 Hz frame
+	void benchmark_wind()
+	{
+		printf("  SSE %s\n", SIMD_SSE ? "on" : "off");
+		run_wind_scene(64, 96, 1);
+		const vec2 single = run_wind_scene(256, 384, 1);
+		const vec2 pool = run_wind_scene(256, 384, 0);
+		printf("  wind %s across thread counts\n", single == pool ? "identical" : "DIFFERS");
+	}
+
+	// One steering pass over 'agent_count' eagles spread over the window, all with a target,
+	// a threat and neighbors. Returns the agents per second.
+	float run_steering_pass(size_t agent_count, JobSystem& jobs)
+	{
+		const SteeringArchetype archetype = AISystem(jobs).archetypes[(int)AGENT_ARCHETYPE::EAGLE];
+		const size_t slot_count = (agent_count + 3) / 4 * 4;
+		SteeringBatch batch;
+		batch.resize(slot_count);
+		std::vector<char> used(slot_count, 0);
+		std::default_random_engine rng(42);
+		std::uniform_real_distribution<float> uniform(0.f, 1.f);
+		// keep the density of a crowded screen, the area grows with the agent count
+		const float side = sqrt((float)agent_count) * 60.f;
+		for (size_t i = 0; i < agent_count; i++)
+		{
+			used[i] = 1;
+			batch.position_x[i] = uniform(rng) * side;
+			batch.position_y[i] = uniform(rng) * side;
+			batch.velocity_x[i] = uniform(rng) * 100.f - 50.f;
+			batch.velocity_y[i] = uniform(rng) * 100.f;
+			batch.target_x[i] = side / 2.f;
+			batch.target_y[i] = side;
+			batch.target_velocity_x[i] = 100.f;
+			batch.target_weight[i] = 1.f;
+			batch.threat_x[i] = batch.position_x[i] + uniform(rng) * 200.f - 100.f;
+			batch.threat_y[i] = batch.position_y[i] + uniform(rng) * 200.f - 100.f;
+			batch.threat_velocity_y[i] = 50.f;
+			batch.threat_weight[i] = 1.f;
+		}
+
+		NeighborGrid grid;
+		const int pass_count = agent_count >= 10000 ? 20 : 200;
+		const Clock::time_point start = Clock::now();
+		for (int pass = 0; pass < pass_count; pass++)
+		{
+			grid.build(batch.position_x.data(), batch.position_y.data(), (unsigned int)slot_count, archetype.separation_radius, used.data());
+			jobs.parallel_for(slot_count / 4, 128, [&](size_t begin, size_t end) {
+				compute_separation(batch, grid, archetype.separation_radius, 4 * begin, 4 * end);
+				steer(archetype, batch, 4 * begin, 4 * end, 1000.f / 60.f);
+			});
+		}
+		const float us = elapsed_us(start) / pass_count;
+		return agent_count / us * 1e6f;
+	}
+
+	// Steering from 100 to 100k agents on one thread and on all
+	void benchmark_steering()
+	{
+		JobSystem single(1);
+		JobSystem& pool = get_job_system();
+		for (size_t agent_count : { 100, 1000, 10000, 100000 })
+		{
+			const float single_rate = run_steering_pass(agent_count, single);
+			const float pool_rate = run_steering_pass(agent_count, pool);
+			printf("  %6zu agents: %8.2f M agents/s on 1 thread (%7.1f us/step), %8.2f M agents/s on %u threads\n",
+				agent_count, single_rate / 1e6f, agent_count / single_rate * 1e6f, pool_rate / 1e6f, pool.get_thread_count());
+		}
+	}
+
+	// 'boid_count' swarm bugs flocking on a square that wraps around, with a few eagles
+	// circling through it that they flee from, for 'step_count' steps on 'jobs'. The boid
+	// density is that of a crowded screen whatever the count. Returns the hash of the final
+	// positions and the microseconds per step.
+	uint32_t run_boids_scene(size_t boid_count, int step_count, JobSystem& jobs, float& out_us)
+	{
+		const SteeringArchetype archetype = AISystem(jobs).archetypes[(int)AGENT_ARCHETYPE::SWARM_BUG];
+		const float step_ms = 1000.f / 60.f;
+		const size_t slot_count = (boid_count + 3) / 4 * 4;
+		const float side = sqrt((float)boid_count) * 40.f;
+		SteeringBatch batch;
+		batch.resize(slot_count);
+		std::vector<char> used(slot_count, 0);
+		std::default_random_engine rng(7);
+		std::uniform_real_distribution<float> uniform(0.f, 1.f);
+		for (size_t i = 0; i < boid_count; i++)
+		{
+			used[i] = 1;
+			batch.position_x[i] = uniform(rng) * side;
+			batch.position_y[i] = uniform(rng) * side;
+			batch.velocity_x[i] = uniform(rng) * 100.f - 50.f;
+			batch.velocity_y[i] = uniform(rng) * 100.f - 50.f;
+		}
+		std::vector<vec2> eagle_centers(boid_count / 500 + 4);
+		for (vec2& center : eagle_centers)
+			center = { uniform(rng) * side, uniform(rng) * side };
+		std::vector<float> eagle_x(eagle_centers.size()), eagle_y(eagle_centers.size());
+
+		NeighborGrid grid, eagle_grid;
+		const float cell_size = max(archetype.separation_radius, archetype.neighbor_radius);
+		const float panic_squared = archetype.panic_radius * archetype.panic_radius;
+		std::vector<float> sorted(slot_count);
+		const Clock::time_point start = Clock::now();
+		for (int step = 0; step < step_count; step++)
+		{
+			// Boids of a cell next to each other in memory make the neighbor lookups about a
+			// third faster, they move less than a cell in a few dozen steps
+			if (step % 30 == 0)
+			{
+				grid.build(batch.position_x.data(), batch.position_y.data(), (unsigned int)slot_count, cell_size, used.data());
+				const std::vector<unsigned int>& order = grid.get_sorted();
+				for (std::vector<float>* array : { &batch.position_x, &batch.position_y, &batch.velocity_x, &batch.velocity_y })
+				{
+					for (size_t i = 0; i < order.size(); i++)
+						sorted[i] = (*array)[order[i]];
+					std::copy(sorted.begin(), sorted.begin() + order.size(), array->begin());
+				}
+			}
+
+			for (size_t e = 0; e < eagle_centers.size(); e++)
+			{
+				const float angle = 0.02f * step + e;
+				eagle_x[e] = eagle_centers[e].x + 150.f * cos(angle);
+				eagle_y[e] = eagle_centers[e].y + 150.f * sin(angle);
+			}
+			grid.build(batch.position_x.data(), batch.position_y.data(), (unsigned int)slot_count, cell_size, used.data());
+			eagle_grid.build(eagle_x.data(), eagle_y.data(), (unsigned int)eagle_x.size(), archetype.panic_radius);
+
+			// The nearest eagle in panic range is the threat, then the flock mates
+			jobs.parallel_for(slot_count / 4, 128, [&](size_t begin, size_t end) {
+				for (size_t i = 4 * begin; i < 4 * end; i++)
+				{
+					float nearest = panic_squared;
+					batch.threat_weight[i] = 0.f;
+					eagle_grid.for_each_near({ batch.position_x[i], batch.position_y[i] }, archetype.panic_radius, [&](unsigned int e) {
+						const float dx = eagle_x[e] - batch.position_x[i], dy = eagle_y[e] - batch.position_y[i];
+						if (dx * dx + dy * dy < nearest)
+						{
+							nearest = dx * dx + dy * dy;
+							batch.threat_x[i] = eagle_x[e];
+							batch.threat_y[i] = eagle_y[e];
+							batch.threat_weight[i] = 1.f;
+						}
+					});
+				}
+				compute_flocking(batch, grid, archetype, 4 * begin, 4 * end, 0, slot_count);
+			});
+			jobs.parallel_for(slot_count / 4, 128, [&](size_t begin, size_t end) {
+				steer(archetype, batch, 4 * begin, 4 * end, step_ms);
+				for (size_t i = 4 * begin; i < 4 * end; i++)
+				{
+					batch.position_x[i] = fmod(batch.position_x[i] + batch.velocity_x[i] * step_ms / 1000.f + side, side);
+					batch.position_y[i] = fmod(batch.position_y[i] + batch.velocity_y[i] * step_ms / 1000.f + side, side);
+				}
+			});
+		}
+		out_us = elapsed_us(start) / step_count;
+
+		// the order of the boids is the same on any number of threads
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < boid_count; i++)
+		{
+			uint32_t bits[2];
+			memcpy(&bits[0], &batch.position_x[i], sizeof(float));
+			memcpy(&bits[1], &batch.position_y[i], sizeof(float));
+			hash = (hash ^ bits[0]) * 16777619u;
+			hash = (hash ^ bits[1]) * 16777619u;
+		}
+		return hash;
+	}
+
+	// Swarm bugs from 1k to 100k, the 60 Hz budget is 16.7 ms per step. The same flock on
+	// one thread, three and all has to end up bit-identical.
+	void benchmark_boids()
+	{
+		JobSystem single(1);
+		JobSystem three(3);
+		JobSystem& pool = get_job_system();
+		for (size_t boid_count : { 1000, 10000, 100000 })
+		{
+			const int step_count = boid_count >= 100000 ? 20 : 60;
+			float single_us, three_us, pool_us;
+			const uint32_t single_hash = run_boids_scene(boid_count, step_count, single, single_us);
+			const uint32_t three_hash = run_boids_scene(boid_count, step_count, three, three_us);
+			const uint32_t pool_hash = run_boids_scene(boid_count, step_count, pool, pool_us);
+			printf("  %6zu boids: %8.1f us/step on 1 thread, %8.1f on 3, %8.1f on %u, %s across thread counts\n",
+				boid_count, single_us, three_us, pool_us, pool.get_thread_count(),
+				single_hash == three_hash && single_hash == pool_hash ? "identical" : "DIFFERS");
+		}
+	}
+
+	// Path queries between random free cells of a window sized map cluttered with stones,
+	// then a few stones move and the same queries are repeated
+	void benchmark_pathfinding()
+	{
+		const size_t obstacle_count = 120;
+		const size_t query_count = 2000;
+		const vec2 window = { (float)window_width_px, (float)window_height_px };
+		std::default_random_engine rng(7);
+		std::uniform_real_distribution<float> uniform(0.f, 1.f);
+		std::vector<vec2> centers(obstacle_count);
+		std::vector<float> radii(obstacle_count);
+		for (size_t i = 0; i < obstacle_count; i++)
+		{
+			centers[i] = vec2(uniform(rng), uniform(rng)) * window;
+			radii[i] = 10.f + uniform(rng) * 20.f;
+		}
+		Pathfinder pathfinder;
+		pathfinder.cache_capacity = query_count;
+		auto add_obstacles = [&]() {
+			pathfinder.begin_obstacles();
+			for (size_t i = 0; i < obstacle_count; i++)
+				pathfinder.add_obstacle(centers[i], radii[i]);
+			return pathfinder.end_obstacles();
+		};
+		add_obstacles();
+
+		std::vector<std::pair<vec2, vec2>> queries;
+		while (queries.size() < query_count)
+		{
+			const vec2 start = vec2(uniform(rng), uniform(rng)) * window;
+			const vec2 goal = vec2(uniform(rng), uniform(rng)) * window;
+			if (!pathfinder.is_blocked(start) && !pathfinder.is_blocked(goal))
+				queries.push_back({ start, goal });
+		}
+
+		std::vector<vec2> waypoints;
+		size_t found = 0;
+		auto run = [&](const char* name, bool direct) {
+			found = 0;
+			const Clock::time_point start = Clock::now();
+			for (const auto& query : queries)
+				found += direct ? pathfinder.find_path_direct(query.first, query.second, waypoints) :
+					pathfinder.find_path(query.first, query.second, waypoints);
+			const float us = elapsed_us(start);
+			printf("  %-24s %9.1f queries/ms (%zu of %zu found)\n", name, queries.size() / us * 1000.f, found, queries.size());
+		};
+		run("jump point search", true);
+		run("hierarchical, uncached", false);
+		run("hierarchical, cached", false);
+
+		// Some stones move by one and a half cells, the paths through them are repaired when
+		// they are asked for again
+		for (size_t i = 0; i < obstacle_count; i += 10)
+			centers[i].x += 15.f;
+		pathfinder.reset_stats();
+		const Clock::time_point update_start = Clock::now();
+		add_obstacles();
+		const float update_us = elapsed_us(update_start);
+		const PathfinderStats& stats = pathfinder.get_stats();
+		printf("  obstacle update %.1f us: %u dirty clusters, %u cached paths kept, %u stale\n",
+			update_us, stats.dirty_clusters, stats.kept_paths, stats.stale_paths);
+		run("after the update", false);
+		printf("  %u of %u queries from the cache, %u stale paths repaired, %u dropped\n",
+			stats.cache_hits, stats.queries, stats.repaired_paths, stats.dropped_paths);
+	}
+
+	// A chicken near the bottom of the window, 50 bugs on screen and 'eagle_count' eagles,
+	// the share 'above' of them just above the window where they spawn. With a 'bug_range'
+	// the bugs are within that distance of the chicken.
+	void add_ai_scene(size_t eagle_count, float above, float bug_range = 0.f)
+	{
+		std::default_random_engine rng(11);
+		std::uniform_real_distribution<float> uniform(0.f, 1.f);
+		auto add_body = [&](vec2 position, vec2 velocity) {
+			Entity entity;
+			Motion& motion = registry.motions.emplace(entity);
+			motion.position = position;
+			motion.velocity = velocity;
+			motion.scale = { 40.f, 40.f };
+			return entity;
+		};
+		const Entity chicken = add_body({ window_width_px / 2.f, window_height_px - 100.f }, { 0, 0 });
+		registry.players.emplace(chicken);
+		registry.motionFlags.emplace(chicken);
+		const vec2 chicken_position = registry.motions.get(chicken).position;
+		for (int i = 0; i < 50; i++)
+		{
+			vec2 position = { uniform(rng) * window_width_px, uniform(rng) * window_height_px };
+			if (bug_range > 0.f)
+			{
+				const float angle = uniform(rng) * 2.f * (float)M_PI;
+				position = chicken_position + sqrt(uniform(rng)) * bug_range * vec2(cos(angle), sin(angle));
+			}
+			const Entity bug = add_body(position, { 0, 50 });
+			registry.eatables.emplace(bug);
+			registry.aiAgents.insert(bug, { AGENT_ARCHETYPE::BUG });
+		}
+		for (size_t i = 0; i < eagle_count; i++)
+		{
+			const float y = i < eagle_count * above ? -100.f - uniform(rng) * 200.f : uniform(rng) * window_height_px;
+			const Entity eagle = add_body({ uniform(rng) * window_width_px, y }, { 0, 100 });
+			registry.deadlys.emplace(eagle);
+			registry.aiAgents.insert(eagle, { AGENT_ARCHETYPE::EAGLE });
+		}
+	}
+
+	// Eagle target selection with the default budget for growing numbers of eagles around a
+	// chicken and a few bugs. The evaluations stay within the budget, the decisions get older
+	// instead, only the bookkeeping per agent grows. With the bugs around the chicken some
+	// eagles go for the bugs instead.
+	void benchmark_utility()
+	{
+		const int tick_count = 60;
+		const float tick_ms = 1000.f / 60.f;
+		const std::pair<size_t, float> scenes[] = { { 15, 0.f }, { 150, 0.f }, { 1500, 0.f }, { 5000, 0.f }, { 15, 150.f }, { 150, 150.f } };
+		for (std::pair<size_t, float> scene : scenes)
+		{
+			const size_t eagle_count = scene.first;
+			add_ai_scene(eagle_count, 0.f, scene.second);
+			PhysicsSystem physics;
+			AISystem ai;
+			ai.init(&physics);
+			float total_us = 0.f, max_us = 0.f, evaluated = 0.f, oldest_ms = 0.f;
+			for (int tick = 0; tick < tick_count; tick++)
+			{
+				physics.step(tick_ms);
+				ai.step(tick_ms);
+				const AIStats& stats = ai.get_stats();
+				total_us += stats.utility_us;
+				max_us = max(max_us, stats.utility_us);
+				evaluated += stats.decisions_evaluated;
+				oldest_ms = max(oldest_ms, stats.oldest_decision_ms);
+			}
+			unsigned int chosen[3] = {};
+			for (const UtilityDecision& decision : registry.utilityDecisions.components)
+				if (decision.option >= 0)
+					chosen[decision.option]++;
+			printf("  %5zu eagles%s: %6.1f us/step (max %6.1f), %7.1f decisions/step, oldest %6.0f ms, %u/%u/%u chicken/bug/frontier\n",
+				eagle_count, scene.second > 0.f ? ", bugs near" : "", total_us / tick_count, max_us, evaluated / tick_count,
+				oldest_ms, chosen[0], chosen[1], chosen[2]);
+			registry.clear_all_components();
+		}
+	}
+
+	// Whole AI steps for growing numbers of eagles, half of them above the window, with the
+	// level of detail tiers and with every agent updated every step
+	void benchmark_ai_lod()
+	{
+		const int tick_count = 60;
+		const float tick_ms = 1000.f / 60.f;
+		for (size_t eagle_count : { 150, 1500, 5000 })
+		{
+			for (bool lod : { false, true })
+			{
+				add_ai_scene(eagle_count, 0.5f);
+				PhysicsSystem physics;
+				AISystem ai;
+				ai.init(&physics);
+				if (!lod)
+					for (unsigned int& period : ai.lod_periods)
+						period = 1;
+				float total_us = 0.f;
+				unsigned int updated[lod_tier_count] = {}, agents[lod_tier_count] = {};
+				for (int tick = 0; tick < tick_count; tick++)
+				{
+					physics.step(tick_ms);
+					ai.step(tick_ms);
+					const AIStats& stats = ai.get_stats();
+					total_us += stats.total_us;
+					for (int t = 0; t < lod_tier_count; t++)
+					{
+						updated[t] += stats.updated_per_tier[t];
+						agents[t] += stats.agents_per_tier[t];
+					}
+				}
+				printf("  %5zu eagles, lod %-3s: %7.1f us/step, updated/agents per step near %6.1f/%6.1f, screen %6.1f/%6.1f, off %6.1f/%6.1f\n",
+					eagle_count, lod ? "on" : "off", total_us / tick_count,
+					(float)updated[0] / tick_count, (float)agents[0] / tick_count,
+					(float)updated[1] / tick_count, (float)agents[1] / tick_count,
+					(float)updated[2] / tick_count, (float)agents[2] / tick_count);
+				registry.clear_all_components();
+			}
+		}
+	}
+
+	// Building an eagle threat map for growing numbers of eagles and querying it at every
+	// eagle, against summing the same cones over all eagles for every query
+	void benchmark_influence()
+	{
+		printf("  SSE %s\n", SIMD_SSE ? "on" : "off");
+		const int tick_count = 60;
+		const float tick_ms = 1000.f / 60.f;
+		const float radius = 150.f;
+		for (size_t eagle_count : { 150, 1500, 15000 })
+		{
+			std::default_random_engine rng(5);
+			std::uniform_real_distribution<float> uniform(0.f, 1.f);
+			std::vector<vec2> eagles(eagle_count);
+			for (vec2& eagle : eagles)
+				eagle = { uniform(rng) * window_width_px, uniform(rng) * window_height_px };
+
+			InfluenceMap map;
+			Clock::time_point start = Clock::now();
+			for (int tick = 0; tick < tick_count; tick++)
+			{
+				map.decay(tick_ms);
+				for (vec2 eagle : eagles)
+					map.splat(eagle, radius, 1.f);
+			}
+			const float build_us = elapsed_us(start) / tick_count;
+
+			std::vector<float> map_values(eagle_count);
+			float slope = 0.f;
+			start = Clock::now();
+			for (size_t i = 0; i < eagle_count; i++)
+			{
+				map_values[i] = map.sample(eagles[i]);
+				slope += length(map.gradient(eagles[i]));
+			}
+			const float map_query_ns = 1000.f * elapsed_us(start) / eagle_count;
+
+			// the scan is quadratic, only time a slice of the queries
+			const size_t scan_count = min(eagle_count, (size_t)500);
+			std::vector<float> scan_values(scan_count, 0.f);
+			start = Clock::now();
+			for (size_t i = 0; i < scan_count; i++)
+				for (vec2 eagle : eagles)
+					scan_values[i] += InfluenceMap::falloff(length(eagle - eagles[i]), radius, 1.f);
+			const float scan_query_ns = 1000.f * elapsed_us(start) / scan_count;
+
+			// relative to the exact sum, the map is low resolution and not quite converged
+			float error = 0.f, total = 0.f;
+			for (size_t i = 0; i < scan_count; i++)
+			{
+				error += abs(map_values[i] - scan_values[i]);
+				total += scan_values[i];
+			}
+			printf("  %5zu eagles: build %7.1f us/step, sample and gradient %6.1f ns (scan %9.1f ns), error %4.1f%%, mean slope %.4f\n",
+				eagle_count, build_us, map_query_ns, scan_query_ns, 100.f * error / total, slope / eagle_count);
+		}
+	}
+
+	// The frontier of eagles between a chicken moving sideways and falling bugs, updated
+	// incrementally with the default tolerances and from scratch every step
+	void benchmark_formation()
+	{
+		const int tick_count = 600;
+		const float tick_s = 1.f / 60.f;
+		struct Size { size_t bugs, eagles; unsigned int slots; };
+		for (Size size : { Size{ 5, 15, 12 }, Size{ 50, 150, 24 }, Size{ 200, 1500, 64 } })
+		{
+			for (bool incremental : { true, false })
+			{
+				std::default_random_engine rng(3);
+				std::uniform_real_distribution<float> uniform(0.f, 1.f);
+				std::vector<vec2> bugs(size.bugs), bug_velocities(size.bugs);
+				for (size_t i = 0; i < size.bugs; i++)
+				{
+					bugs[i] = { uniform(rng) * window_width_px, uniform(rng) * window_height_px / 2.f };
+					bug_velocities[i] = { uniform(rng) * 20.f - 10.f, 20.f + uniform(rng) * 30.f };
+				}
+				std::vector<Entity> eagles(size.eagles);
+				std::vector<vec2> eagle_positions(size.eagles);
+				for (vec2& position : eagle_positions)
+					position = { uniform(rng) * window_width_px, uniform(rng) * window_height_px };
+
+				Formation formation;
+				formation.max_slots = size.slots;
+				if (!incremental)
+				{
+					formation.hull_tolerance = 0.f;
+					formation.reassign_distance = 0.f;
+					formation.rows_per_step = size.slots;
+				}
+				float total_us = 0.f, max_us = 0.f;
+				for (int tick = 0; tick < tick_count; tick++)
+				{
+					const vec2 chicken = { window_width_px * (0.5f + 0.4f * sin(tick * tick_s)), window_height_px - 100.f };
+					for (size_t i = 0; i < size.bugs; i++)
+					{
+						bugs[i] += bug_velocities[i] * tick_s;
+						if (bugs[i].y > window_height_px - 200.f)
+							bugs[i].y -= window_height_px / 2.f;
+					}
+					// the eagles drift towards their slots
+					for (size_t i = 0; i < size.eagles; i++)
+					{
+						vec2 slot;
+						if (formation.get_slot(eagles[i], slot))
+							eagle_positions[i] += (slot - eagle_positions[i]) * min(1.f, 2.f * tick_s);
+					}
+					const Clock::time_point start = Clock::now();
+					formation.update(chicken, bugs, eagles, eagle_positions);
+					const float us = elapsed_us(start);
+					total_us += us;
+					max_us = max(max_us, us);
+				}
+				const FormationStats& stats = formation.get_stats();
+				printf("  %3zu bugs, %4zu eagles, %2u slots, %-11s: %7.1f us/step (max %7.1f), %3u hulls, %3u/%3u assignments, %5.1f rows/step\n",
+					size.bugs, size.eagles, size.slots, incremental ? "incremental" : "every step", total_us / tick_count, max_us,
+					stats.hull_rebuilds, stats.assignments_finished, stats.assignments_started, (float)stats.rows_assigned / tick_count);
+			}
+		}
+	}
+
+	// Whole AI steps with 1500 eagles, falling stones and bugs walking to destinations that
+	// change every second, planning the paths and the formation in the step and on the
+	// worker of the planner. The step only pays for the snapshot and the apply with the worker,
+	// the plans get older instead.
+	void benchmark_planning()
+	{
+		const int tick_count = 300;
+		const float tick_ms = 1000.f / 60.f;
+		const vec2 window = { (float)window_width_px, (float)window_height_px };
+		for (size_t walker_count : { 50, 500 })
+		{
+			for (bool async : { false, true })
+			{
+				add_ai_scene(1500, 0.f);
+				std::default_random_engine rng(5);
+				std::uniform_real_distribution<float> uniform(0.f, 1.f);
+				for (int i = 0; i < 40; i++)
+				{
+					Entity stone;
+					Motion& motion = registry.motions.emplace(stone);
+					motion.position = vec2(uniform(rng), uniform(rng) * 0.5f) * window;
+					motion.velocity = { 0.f, 75.f };
+					motion.scale = { 40.f + uniform(rng) * 40.f, 40.f + uniform(rng) * 40.f };
+					registry.obstacles.emplace(stone);
+				}
+				std::vector<Entity> walkers;
+				for (size_t i = 0; i < walker_count; i++)
+				{
+					Entity walker;
+					Motion& motion = registry.motions.emplace(walker);
+					motion.position = vec2(uniform(rng), uniform(rng)) * window;
+					motion.scale = { 20.f, 20.f };
+					registry.aiAgents.insert(walker, { AGENT_ARCHETYPE::BUG });
+					walkers.push_back(walker);
+				}
+
+				PhysicsSystem physics;
+				AISystem ai;
+				ai.init(&physics);
+				ai.async_planning = async;
+				float total_us = 0.f, planning_us = 0.f, max_planning_us = 0.f, plan_us = 0.f, age = 0.f;
+				unsigned int plans = 0, stale = 0, requested = 0, planned = 0;
+				for (int tick = 0; tick < tick_count; tick++)
+				{
+					for (size_t i = tick % 60; i < walkers.size(); i += 60)
+					{
+						AIAgent& agent = registry.aiAgents.get(walkers[i]);
+						agent.has_destination = true;
+						agent.destination = vec2(uniform(rng), uniform(rng)) * window;
+					}
+					physics.step(tick_ms);
+					ai.step(tick_ms);
+					const AIStats& stats = ai.get_stats();
+					total_us += stats.total_us;
+					planning_us += stats.planning_us;
+					max_planning_us = max(max_planning_us, stats.planning_us);
+					plans += stats.snapshot_published;
+					plan_us += stats.plan_us;
+					age += stats.plan_age;
+					stale += stats.plan_stale;
+					requested += stats.paths_requested;
+					planned += stats.paths_planned;
+				}
+				printf("  %3zu walkers, %-8s: %7.1f us/step, planning in the step %6.1f us (max %7.1f), plan %7.1f us, %5.1f plans/s, age %4.1f steps, %3u stale, %5.1f/%5.1f paths requested/planned per step\n",
+					walker_count, async ? "worker" : "in step", total_us / tick_count, planning_us / tick_count, max_planning_us,
+					plan_us / tick_count, plans * 60.f / tick_count, age / tick_count, stale,
+					(float)requested / tick_count, (float)planned / tick_count);
+				registry.clear_all_components();
+			}
+		}
+	}
+
+	struct Benchmark
+	{
+		const char* name;
+		void (*run)();
+	};
+
+	// Add new benchmarks here
+	const Benchmark benchmarks[] = {
+		{ "fixed_point", benchmark_fixed_point },
+		{ "rigid_bodies", benchmark_rigid_bodies },
+		{ "wind", benchmark_wind },
+		{ "steering", benchmark_steering },
+		{ "boids", benchmark_boids },
+		{ "pathfinding", benchmark_pathfinding },
+		{ "utility", benchmark_utility },
+		{ "ai_lod", benchmark_ai_lod },
+		{ "influence", benchmark_influence },
+		{ "formation", benchmark_formation },
+		{ "planning", benchmark_planning },
+	};
+}
+
+int run_benchmark(const std::string& name)
+{
+	bool found = false;
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		if (name != "all" && name != benchmark.name)
+			continue;
+		printf("== %s\n", benchmark.name);
+		benchmark.run();
+		found = true;
+	}
+
+	if (!found)
+	{
+		fprintf(stderr, "Unknown benchmark %s, available are: all", name.c_str());
+		for (const Benchmark& benchmark : benchmarks)
+			fprintf(stderr, ", %s", benchmark.name);
+		fprintf(stderr, "\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
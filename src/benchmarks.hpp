@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Headless benchmarks, run with `chicken --benchmark <name>` or `chicken --benchmark all`.
+// They don't open a window or audio device and print their timings to stdout.
+int run_benchmark(const std::string& name);
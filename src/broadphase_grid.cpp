@@ -0,0 +1,70 @@
+// internal
+#include "broadphase_grid.hpp"
+
+// Entities spawn and leave slightly outside the window, cover a margin around it
+BroadphaseGrid::BroadphaseGrid(float cell_size_arg, float margin)
+	: BroadphaseGrid(vec2(-margin), vec2(window_width_px, window_height_px) + margin, cell_size_arg)
+{
+}
+
+BroadphaseGrid::BroadphaseGrid(vec2 area_min, vec2 area_max, float cell_size_arg)
+	: cell_size(cell_size_arg)
+{
+	origin = area_min;
+	dims = max(ivec2(ceil((area_max - area_min) / cell_size)), ivec2(1));
+	cell_start.assign(dims.x * dims.y + 1, 0);
+	cell_awake_end.assign(dims.x * dims.y, 0);
+	fill.assign(dims.x * dims.y, 0);
+}
+
+ivec2 BroadphaseGrid::get_cell(vec2 position) const
+{
+	ivec2 cell = ivec2(floor((position - origin) / cell_size));
+	return clamp(cell, ivec2(0), dims - 1);
+}
+
+void BroadphaseGrid::get_cell_range(vec2 min_corner, vec2 max_corner, ivec2& out_min, ivec2& out_max) const
+{
+	out_min = get_cell(min_corner);
+	out_max = get_cell(max_corner);
+}
+
+void BroadphaseGrid::build(const vec2* aabb_min, const vec2* aabb_max, const char* asleep, unsigned int count)
+{
+	box_min.assign(aabb_min, aabb_min + count);
+	box_max.assign(aabb_max, aabb_max + count);
+
+	// Pass 1: count the entries of every cell
+	std::fill(cell_start.begin(), cell_start.end(), 0);
+	for (unsigned int b = 0; b < count; b++)
+	{
+		ivec2 lo, hi;
+		get_cell_range(aabb_min[b], aabb_max[b], lo, hi);
+		for (int y = lo.y; y <= hi.y; y++)
+			for (int x = lo.x; x <= hi.x; x++)
+				cell_start[y * dims.x + x + 1]++;
+	}
+
+	// Prefix sum, cell_start[c] becomes the first entry of cell c
+	for (size_t c = 1; c < cell_start.size(); c++)
+		cell_start[c] += cell_start[c - 1];
+	entries.resize(cell_start.back());
+
+	// Pass 2: scatter, awake bodies first so that they are at the front of every cell
+	std::copy(cell_start.begin(), cell_start.end() - 1, fill.begin());
+	for (int sleeping = 0; sleeping < 2; sleeping++)
+	{
+		for (unsigned int b = 0; b < count; b++)
+		{
+			if ((asleep[b] != 0) != (sleeping == 1))
+				continue;
+			ivec2 lo, hi;
+			get_cell_range(aabb_min[b], aabb_max[b], lo, hi);
+			for (int y = lo.y; y <= hi.y; y++)
+				for (int x = lo.x; x <= hi.x; x++)
+					entries[fill[y * dims.x + x]++] = b;
+		}
+		if (sleeping == 0)
+			std::copy(fill.begin(), fill.end(), cell_awake_end.begin());
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+
+// Uniform grid over the play area used as collision broadphase. Bodies are binned by
+// their axis-aligned bounding box with a counting sort, so a rebuild is two linear passes
+// and allocates nothing once the buffers have grown. Bodies outside the play area are
+// clamped into the border cells.
+class BroadphaseGrid
+{
+public:
+	BroadphaseGrid(float cell_size = 64.f, float margin = 256.f);
+	// Grid over an arbitrary area instead of the window
+	BroadphaseGrid(vec2 area_min, vec2 area_max, float cell_size);
+
+	// Bins 'count' bodies given by their bounding boxes. Within every cell the awake bodies
+	// are stored before the sleeping ones, so that pair enumeration can skip
+	// sleeping-vs-sleeping pairs without looking at them.
+	void build(const vec2* aabb_min, const vec2* aabb_max, const char* asleep, unsigned int count);
+
+	// Calls on_pair(a, b) once for every pair of bodies whose bounding boxes overlap and
+	// of which at least one is awake
+	template <class Callback>
+	void for_each_pair(Callback on_pair) const;
+
+	// Range of cells covered by a box, clamped to the grid
+	void get_cell_range(vec2 box_min, vec2 box_max, ivec2& out_min, ivec2& out_max) const;
+
+	// Bodies stored in a cell, [begin, end) into the entry list
+	unsigned int cell_begin(int x, int y) const { return cell_start[y * dims.x + x]; }
+	unsigned int cell_end(int x, int y) const { return cell_start[y * dims.x + x + 1]; }
+	unsigned int entry(unsigned int index) const { return entries[index]; }
+
+	ivec2 get_dims() const { return dims; }
+	float get_cell_size() const { return cell_size; }
+	vec2 get_origin() const { return origin; }
+	const vec2& get_min(unsigned int body) const { return box_min[body]; }
+	const vec2& get_max(unsigned int body) const { return box_max[body]; }
+	unsigned int body_count() const { return (unsigned int)box_min.size(); }
+
+private:
+	ivec2 get_cell(vec2 position) const;
+
+	float cell_size;
+	vec2 origin;
+	ivec2 dims;
+
+	// copies of the bounding boxes given to build(), needed for the pair de-duplication
+	std::vector<vec2> box_min;
+	std::vector<vec2> box_max;
+	// prefix sums of the cell occupancy, cell c holds entries[cell_start[c] .. cell_start[c+1])
+	std::vector<unsigned int> cell_start;
+	std::vector<unsigned int> cell_awake_end;
+	std::vector<unsigned int> entries;
+	std::vector<unsigned int> fill;
+};
+
+template <class Callback>
+void BroadphaseGrid::for_each_pair(Callback on_pair) const
+{
+	for (int y = 0; y < dims.y; y++)
+	{
+		for (int x = 0; x < dims.x; x++)
+		{
+			const int cell = y * dims.x + x;
+			const unsigned int begin = cell_start[cell];
+			const unsigned int end = cell_start[cell + 1];
+			// the first body of a pair is always awake, sleeping bodies are only partners
+			for (unsigned int i = begin; i < cell_awake_end[cell]; i++)
+			{
+				const unsigned int a = entries[i];
+				for (unsigned int k = i + 1; k < end; k++)
+				{
+					const unsigned int b = entries[k];
+					if (box_max[a].x < box_min[b].x || box_max[b].x < box_min[a].x ||
+						box_max[a].y < box_min[b].y || box_max[b].y < box_min[a].y)
+						continue;
+					// Bodies spanning several cells meet in all of them, only report the
+					// pair in the cell holding the lower corner of the box intersection
+					const ivec2 owner = get_cell(max(box_min[a], box_min[b]));
+					if (owner.x != x || owner.y != y)
+						continue;
+					on_pair(a, b);
+				}
+			}
+		}
+	}
+}
@@ -38,7 +38,9 @@ struct LightUp {
 // Any lighted weighted creatures can be blowable
 struct Blowable
 {
-
+	// Velocity of the wind at the entity, written by the WindSystem and added to
+	// Motion::velocity when the entity is integrated
+	vec2 wind_velocity = { 0.f, 0.f };
 };
 
 // Motion flags for the Chicken
@@ -60,18 +62,160 @@ struct Motion {
 	vec2 scale = { 10, 10 };
 };
 
+// Motion state at the start of the current simulation tick, the renderer
+// interpolates from it towards the current Motion with the leftover tick fraction
+struct PreviousMotion {
+	vec2 position = { 0, 0 };
+	float angle = 0;
+	vec2 scale = { 10, 10 };
+};
+
+// Rest state of a body in the physics system. Bodies that stay (nearly) still fall
+// asleep and are neither integrated nor tested against other sleeping bodies.
+struct PhysicsBody
+{
+	bool asleep = false;
+	int still_ticks = 0;
+	vec2 rest_position = { 0, 0 }; // where the body fell asleep, moving it wakes it up
+};
+
+// Circular body simulated by the RigidBodySolver (with gravity, contacts and friction)
+// instead of the plain velocity integration. Position, velocity and angle live in Motion.
+struct RigidBody
+{
+	float radius = 10.f;
+	float inverse_mass = 1.f; // 0 makes the body immovable
+	float restitution = 0.2f;
+	float friction = 0.5f;
+	float angular_velocity = 0.f; // radians per second
+	float still_time = 0.f; // seconds spent below the solver's sleep velocity
+	bool asleep = false;
+};
+
+// How the physics system keeps an entity inside the window. CLAMP stops the entity at the
+// border, REFLECT bounces it back and DESPAWN flags it with OutOfBounds once it has left
+// the window completely and is not heading back in.
+enum class BOUNDARY_POLICY {
+	NONE = 0,
+	CLAMP = NONE + 1,
+	REFLECT = CLAMP + 1,
+	DESPAWN = REFLECT + 1
+};
+struct Boundary
+{
+	BOUNDARY_POLICY policy = BOUNDARY_POLICY::DESPAWN;
+};
+
+// Set by the physics system on DESPAWN entities that left the window, the world system
+// removes all flagged entities at once
+struct OutOfBounds
+{
+};
+
+// Kinds of AI agents, every archetype has its own row of steering weights in the AISystem
+enum class AGENT_ARCHETYPE {
+	EAGLE = 0,
+	BUG = EAGLE + 1,
+	SWARM_BUG = BUG + 1, // flocking bugs of the swarm mode
+	ARCHETYPE_COUNT = SWARM_BUG + 1
+};
+const int archetype_count = (int)AGENT_ARCHETYPE::ARCHETYPE_COUNT;
+
+// Entity steered by the AISystem, which writes its Motion::velocity every step
+struct AIAgent
+{
+	AGENT_ARCHETYPE archetype = AGENT_ARCHETYPE::EAGLE;
+	// Agents with a destination follow a path to it instead of the flow field to the chicken
+	bool has_destination = false;
+	vec2 destination = { 0, 0 };
+	bool fleeing = false; // the destination is a safe spot the AISystem picked
+	// Level of detail, assigned by the AISystem every step. Between updates the agent
+	// coasts on its velocity.
+	int lod_tier = 0;
+	bool due = true; // updated in this step
+	unsigned int steps_since_update = 0;
+	float ms_since_update = 0.f;
+};
+
+// Path of an AIAgent with a destination, kept by the AISystem
+struct AIPath
+{
+	std::vector<vec2> waypoints;
+	size_t next = 0; // waypoint the agent is heading for
+	vec2 destination = { 0, 0 };
+	unsigned int version = 0; // of the Pathfinder obstacles it was planned with
+	bool requested = false; // waiting for the Planner
+	unsigned int failures = 0; // plans in a row without a path to the destination
+	unsigned int retry_step = 0; // AISystem step from which a missing path is requested again
+};
+
+// State of an AIAgent in the behavior tree of its archetype, kept by the AISystem. The
+// actions set the weights the steering behaviors of the agent are scaled with.
+struct Blackboard
+{
+	int running_node = -1; // action to resume in the next tick, -1 to start from the root
+	float running_ms = 0.f; // since the running action started
+	float target_weight = 1.f;
+	float threat_weight = 1.f;
+	float flow_weight = 1.f;
+	bool in_formation = false; // holds a frontier slot, which is its target
+};
+
+// Something an agent could go for: an entity, a point relative to one or a fixed point
+struct UtilityCandidate
+{
+	Entity target; // only with has_target
+	bool has_target = false;
+	vec2 offset = { 0, 0 }; // from the target, or the position without target
+
+	// Candidates are made for every evaluation, Entity() would take a new id each time
+	UtilityCandidate() : target(no_target) {}
+	explicit UtilityCandidate(Entity target) : target(target), has_target(true) {}
+
+private:
+	static const Entity no_target;
+};
+
+// Choice of an AIAgent whose archetype has a UtilityReasoner, reused until the AISystem
+// gets around to re-evaluating it
+struct UtilityDecision
+{
+	int option = -1; // of the reasoner, -1 for none
+	UtilityCandidate candidate;
+	float score = 0.f;
+	float age_ms = 0.f; // since the last evaluation
+};
+
+// Makes paths of AI agents through the entity's bounding circle more expensive, by 'cost'
+// times the cost of open ground, in the flow field. The Pathfinder doesn't path through it.
+struct Obstacle
+{
+	float cost = 10.f;
+};
+
+// Contact events emitted by the physics system: BEGIN when two entities start touching,
+// END when they separate (or one of them is removed) and, if enabled, STAY every step in between
+enum class CONTACT_EVENT {
+	BEGIN = 0,
+	STAY = BEGIN + 1,
+	END = STAY + 1
+};
+
 // Stucture to store collision information
 struct Collision
 {
 	// Note, the first object is stored in the ECS container.entities
 	Entity other; // the second object involved in the collision
-	Collision(Entity& other) { this->other = other; };
+	CONTACT_EVENT event = CONTACT_EVENT::BEGIN;
+	// Copies 'other' directly, a default constructed entity would take a new id for every event
+	Collision(Entity& other, CONTACT_EVENT event = CONTACT_EVENT::BEGIN) : other(other), event(event) {};
 };
 
 // Data structure for toggling debug mode
 struct Debug {
 	bool in_debug_mode = 0;
 	bool in_freeze_mode = 0;
+	bool log_physics_stats = 0;
 };
 extern Debug debugging;
 
@@ -0,0 +1,48 @@
+// internal
+#include "debug_draw.hpp"
+
+// Line list of the current step, the capacity is kept between steps
+static std::vector<ColoredVertex> debug_vertices;
+
+// Depth of the debug lines, same as the former debug line entities
+const float DEBUG_DEPTH = 0.5f;
+
+void debug_draw_line(vec2 from, vec2 to, vec3 color)
+{
+	debug_vertices.push_back({ vec3(from, DEBUG_DEPTH), color });
+	debug_vertices.push_back({ vec3(to, DEBUG_DEPTH), color });
+}
+
+void debug_draw_polygon(const vec2* points, int count, vec3 color)
+{
+	for (int i = 0; i < count; i++)
+		debug_draw_line(points[i], points[(i + 1) % count], color);
+}
+
+void debug_draw_box(vec2 box_min, vec2 box_max, vec3 color)
+{
+	const vec2 corners[4] = { box_min, { box_max.x, box_min.y }, box_max, { box_min.x, box_max.y } };
+	debug_draw_polygon(corners, 4, color);
+}
+
+void debug_draw_circle(vec2 center, float radius, vec3 color, int segments)
+{
+	vec2 previous = center + vec2(radius, 0.f);
+	for (int i = 1; i <= segments; i++)
+	{
+		const float t = float(i) * 2.f * (float)M_PI / float(segments);
+		const vec2 next = center + radius * vec2(cos(t), sin(t));
+		debug_draw_line(previous, next, color);
+		previous = next;
+	}
+}
+
+void debug_draw_clear()
+{
+	debug_vertices.clear();
+}
+
+const std::vector<ColoredVertex>& debug_draw_vertices()
+{
+	return debug_vertices;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "components.hpp"
+
+// Immediate mode debug drawing. Systems add lines, boxes and circles in world coordinates
+// during a step, the shapes are accumulated in a single vertex array (two ColoredVertex
+// per line segment) that the RenderSystem draws with one draw call. The array is cleared
+// at the start of every world step, together with the other debug info of the last step.
+const vec3 DEBUG_RED = { 0.8f, 0.1f, 0.1f };
+
+void debug_draw_line(vec2 from, vec2 to, vec3 color = DEBUG_RED);
+// closed outline through 'count' points
+void debug_draw_polygon(const vec2* points, int count, vec3 color = DEBUG_RED);
+void debug_draw_box(vec2 box_min, vec2 box_max, vec3 color = DEBUG_RED);
+void debug_draw_circle(vec2 center, float radius, vec3 color = DEBUG_RED, int segments = 24);
+
+void debug_draw_clear();
+const std::vector<ColoredVertex>& debug_draw_vertices();
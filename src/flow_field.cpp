@@ -0,0 +1,145 @@
+// internal
+#include "flow_field.hpp"
+
+// stlib
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+
+// Neighbor offsets, straight ones first
+const ivec2 NEIGHBOR_OFFSETS[8] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 } };
+const float NEIGHBOR_LENGTHS[8] = { 1.f, 1.f, 1.f, 1.f, 1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f };
+
+FlowField::FlowField(vec2 area_size, float cell_size_arg)
+	: cell_size(cell_size_arg)
+{
+	dims = { (int)ceil(area_size.x / cell_size), (int)ceil(area_size.y / cell_size) };
+	const size_t cell_count = (size_t)dims.x * dims.y;
+	cost.assign(cell_count, 1.f);
+	next_cost.assign(cell_count, 1.f);
+	distance.assign(cell_count, FLT_MAX);
+	direction.assign(cell_count, { 0.f, 0.f });
+}
+
+int FlowField::get_cell(vec2 position) const
+{
+	const int x = max(0, min(dims.x - 1, (int)floor(position.x / cell_size)));
+	const int y = max(0, min(dims.y - 1, (int)floor(position.y / cell_size)));
+	return y * dims.x + x;
+}
+
+void FlowField::begin_obstacles()
+{
+	std::fill(next_cost.begin(), next_cost.end(), 1.f);
+}
+
+void FlowField::add_obstacle(vec2 center, float radius, float obstacle_cost)
+{
+	const ivec2 cell_min = max(ivec2(0), ivec2(floor((center - radius) / cell_size)));
+	const ivec2 cell_max = min(dims - 1, ivec2(floor((center + radius) / cell_size)));
+	for (int y = cell_min.y; y <= cell_max.y; y++)
+	{
+		for (int x = cell_min.x; x <= cell_max.x; x++)
+		{
+			// the closest point of the cell to the center decides whether the circle covers it
+			const vec2 cell_low = vec2(x, y) * cell_size;
+			const vec2 closest = clamp(center, cell_low, cell_low + cell_size);
+			const vec2 d = closest - center;
+			if (dot(d, d) <= radius * radius)
+				next_cost[y * dims.x + x] += obstacle_cost;
+		}
+	}
+}
+
+bool FlowField::update(vec2 goal_arg)
+{
+	goal = goal_arg;
+	const int cell = get_cell(goal);
+	if (cell == goal_cell && next_cost == cost)
+		return false;
+	goal_cell = cell;
+	cost.swap(next_cost);
+	integrate();
+	rebuild_count++;
+	return true;
+}
+
+void FlowField::clear_goal()
+{
+	goal_cell = -1;
+	std::fill(direction.begin(), direction.end(), vec2(0.f, 0.f));
+}
+
+void FlowField::integrate()
+{
+	// Dijkstra from the goal, leaving a cell costs the average of the two cells' costs
+	std::fill(distance.begin(), distance.end(), FLT_MAX);
+	heap.clear();
+	distance[goal_cell] = 0.f;
+	heap.push_back({ 0.f, goal_cell });
+	const auto later = std::greater<std::pair<float, int>>();
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), later);
+		const std::pair<float, int> top = heap.back();
+		heap.pop_back();
+		const int cell = top.second;
+		if (top.first > distance[cell])
+			continue; // outdated entry, the cell was reached more cheaply since
+		const ivec2 position = { cell % dims.x, cell / dims.x };
+		for (int k = 0; k < 8; k++)
+		{
+			const ivec2 next = position + NEIGHBOR_OFFSETS[k];
+			if (next.x < 0 || next.y < 0 || next.x >= dims.x || next.y >= dims.y)
+				continue;
+			const int next_cell = next.y * dims.x + next.x;
+			const float next_distance = top.first + NEIGHBOR_LENGTHS[k] * 0.5f * (cost[cell] + cost[next_cell]);
+			if (next_distance < distance[next_cell])
+			{
+				distance[next_cell] = next_distance;
+				heap.push_back({ next_distance, next_cell });
+				std::push_heap(heap.begin(), heap.end(), later);
+			}
+		}
+	}
+
+	// Every cell points at its closest neighbor
+	for (int cell = 0; cell < (int)distance.size(); cell++)
+	{
+		const ivec2 position = { cell % dims.x, cell / dims.x };
+		float best = distance[cell];
+		vec2 best_direction = { 0.f, 0.f };
+		for (int k = 0; k < 8; k++)
+		{
+			const ivec2 next = position + NEIGHBOR_OFFSETS[k];
+			if (next.x < 0 || next.y < 0 || next.x >= dims.x || next.y >= dims.y)
+				continue;
+			const float next_distance = distance[next.y * dims.x + next.x];
+			if (next_distance < best)
+			{
+				best = next_distance;
+				best_direction = vec2(NEIGHBOR_OFFSETS[k]) / NEIGHBOR_LENGTHS[k];
+			}
+		}
+		direction[cell] = best_direction;
+	}
+}
+
+vec2 FlowField::get_direction(vec2 position) const
+{
+	if (goal_cell < 0)
+		return { 0.f, 0.f };
+	const int cell = get_cell(position);
+	if (cell == goal_cell)
+	{
+		const vec2 to_goal = goal - position;
+		const float length = sqrt(dot(to_goal, to_goal));
+		return length > 1e-3f ? to_goal / length : vec2(0.f, 0.f);
+	}
+	return direction[cell];
+}
+
+float FlowField::get_distance(vec2 position) const
+{
+	return goal_cell < 0 ? FLT_MAX : distance[get_cell(position)];
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+
+// Shortest paths from every cell of a coarse grid over the window to one goal, shared by
+// all agents heading there. The integration field holds the cost of the cheapest path to
+// the goal (Dijkstra with eight neighbors), obstacles make their cells more expensive
+// instead of blocking them. Each cell points at its cheapest neighbor, so an agent's
+// direction is one lookup. The fields are only recomputed when the goal enters another
+// cell or the obstacle costs change.
+class FlowField
+{
+public:
+	FlowField(vec2 area_size = { (float)window_width_px, (float)window_height_px }, float cell_size = 20.f);
+
+	// Obstacles are collected between begin_obstacles() and update(), each one adds 'cost'
+	// to the cells its circle covers (a free cell costs 1)
+	void begin_obstacles();
+	void add_obstacle(vec2 center, float radius, float cost);
+
+	// Moves the goal and recomputes the fields if the goal cell or the costs changed,
+	// returns true if they were recomputed
+	bool update(vec2 goal);
+	// No goal, all directions are 0
+	void clear_goal();
+
+	// Unit direction of the cheapest path at a position, positions outside of the grid use
+	// the closest border cell. Within the goal cell it points straight at the goal.
+	vec2 get_direction(vec2 position) const;
+	// Cost of the cheapest path from the cell of the position to the goal
+	float get_distance(vec2 position) const;
+
+	bool has_goal() const { return goal_cell >= 0; }
+	ivec2 get_dims() const { return dims; }
+	float get_cell_size() const { return cell_size; }
+	vec2 get_cell_center(int cell) const { return { (cell % dims.x + 0.5f) * cell_size, (cell / dims.x + 0.5f) * cell_size }; }
+	unsigned int get_rebuild_count() const { return rebuild_count; }
+
+private:
+	int get_cell(vec2 position) const;
+	void integrate();
+
+	float cell_size;
+	ivec2 dims;
+	vec2 goal = { 0, 0 };
+	int goal_cell = -1;
+	unsigned int rebuild_count = 0;
+
+	std::vector<float> cost; // of entering a cell, used by the current fields
+	std::vector<float> next_cost; // collected obstacles, compared with 'cost' on update
+	std::vector<float> distance;
+	std::vector<vec2> direction;
+	std::vector<std::pair<float, int>> heap; // open list of (distance, cell) as a min-heap
+};
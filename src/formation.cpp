@@ -0,0 +1,343 @@
+// internal
+#include "formation.hpp"
+
+// stlib
+#include <algorithm>
+#include <cfloat>
+
+void AssignmentSolver::begin(unsigned int rows_arg, unsigned int columns_arg, const std::vector<float>& cost_arg)
+{
+	rows = rows_arg;
+	columns = columns_arg;
+	cost = cost_arg;
+	next_row = 1;
+	row_potential.assign(rows + 1, 0.f);
+	column_potential.assign(columns + 1, 0.f);
+	column_row.assign(columns + 1, 0);
+	way.assign(columns + 1, 0);
+	row_column.assign(rows, -1);
+}
+
+bool AssignmentSolver::step(unsigned int max_rows)
+{
+	for (unsigned int added = 0; added < max_rows && next_row <= rows; added++, next_row++)
+	{
+		// Shortest augmenting path from the new row to a free column over the reduced costs,
+		// Dijkstra style, with the potentials keeping all reduced costs non-negative
+		column_row[0] = next_row;
+		int column = 0;
+		min_slack.assign(columns + 1, FLT_MAX);
+		visited.assign(columns + 1, 0);
+		do
+		{
+			visited[column] = 1;
+			const int row = column_row[column];
+			float delta = FLT_MAX;
+			int next_column = 0;
+			for (unsigned int j = 1; j <= columns; j++)
+			{
+				if (visited[j])
+					continue;
+				const float slack = cost[(row - 1) * columns + (j - 1)] - row_potential[row] - column_potential[j];
+				if (slack < min_slack[j])
+				{
+					min_slack[j] = slack;
+					way[j] = column;
+				}
+				if (min_slack[j] < delta)
+				{
+					delta = min_slack[j];
+					next_column = j;
+				}
+			}
+			for (unsigned int j = 0; j <= columns; j++)
+			{
+				if (visited[j])
+				{
+					row_potential[column_row[j]] += delta;
+					column_potential[j] -= delta;
+				}
+				else
+					min_slack[j] -= delta;
+			}
+			column = next_column;
+		} while (column_row[column] != 0);
+
+		// Flip the assignments along the path
+		do
+		{
+			const int previous = way[column];
+			column_row[column] = column_row[previous];
+			column = previous;
+		} while (column != 0);
+	}
+
+	if (!is_done())
+		return false;
+	for (unsigned int j = 1; j <= columns; j++)
+		if (column_row[j] > 0)
+			row_column[column_row[j] - 1] = j - 1;
+	return true;
+}
+
+namespace {
+	float cross(vec2 a, vec2 b)
+	{
+		return a.x * b.y - a.y * b.x;
+	}
+
+	float polyline_length(const std::vector<vec2>& points)
+	{
+		float total = 0.f;
+		for (size_t i = 1; i < points.size(); i++)
+			total += length(points[i] - points[i - 1]);
+		return total;
+	}
+}
+
+void Formation::clear()
+{
+	hull_bugs.clear();
+	hull.clear();
+	front.clear();
+	slots.clear();
+	member_slot.clear();
+	assigned_ids.clear();
+	assigned_slots.clear();
+	solving = false;
+}
+
+bool Formation::hull_is_stale(const std::vector<vec2>& bugs) const
+{
+	if (bugs.size() != hull_bugs.size())
+		return true;
+	const float tolerance_squared = hull_tolerance * hull_tolerance;
+	for (size_t i = 0; i < bugs.size(); i++)
+	{
+		const vec2 d = bugs[i] - hull_bugs[i];
+		if (dot(d, d) > tolerance_squared)
+			return true;
+	}
+	return false;
+}
+
+void Formation::build_hull(const std::vector<vec2>& bugs)
+{
+	// Monotone chain, the lower and the upper half from the points sorted by x
+	hull_bugs = bugs;
+	std::vector<vec2> points = bugs;
+	std::sort(points.begin(), points.end(), [](vec2 a, vec2 b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+	hull.clear();
+	if (points.size() < 3)
+	{
+		hull = points;
+		if (hull.size() == 2 && hull[0] == hull[1])
+			hull.pop_back();
+		stats.hull_rebuilds++;
+		return;
+	}
+	hull.resize(2 * points.size());
+	size_t count = 0;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		while (count >= 2 && cross(hull[count - 1] - hull[count - 2], points[i] - hull[count - 2]) <= 0.f)
+			count--;
+		hull[count++] = points[i];
+	}
+	const size_t lower_count = count + 1;
+	for (size_t i = points.size() - 1; i-- > 0;)
+	{
+		while (count >= lower_count && cross(hull[count - 1] - hull[count - 2], points[i] - hull[count - 2]) <= 0.f)
+			count--;
+		hull[count++] = points[i];
+	}
+	hull.resize(count - 1); // the last point is the first one again
+	stats.hull_rebuilds++;
+}
+
+void Formation::find_front(vec2 chicken)
+{
+	front.clear();
+	const size_t count = hull.size();
+	if (count <= 2)
+	{
+		front = hull;
+		return;
+	}
+
+	// The edges the chicken is on the outer side of, they form one chain of the hull
+	vec2 center = { 0, 0 };
+	for (vec2 point : hull)
+		center += point;
+	center /= (float)count;
+	auto visible = [&](size_t i) {
+		const vec2 a = hull[i], b = hull[(i + 1) % count];
+		return cross(b - a, chicken - a) * cross(b - a, center - a) < 0.f;
+	};
+	size_t first = count;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (visible(i) && !visible((i + count - 1) % count))
+		{
+			first = i;
+			break;
+		}
+	}
+	if (first == count)
+		return; // the chicken is among the bugs
+	front.push_back(hull[first]);
+	for (size_t i = first; visible(i % count) && front.size() <= count; i++)
+		front.push_back(hull[(i + 1) % count]);
+}
+
+void Formation::place_slots(vec2 chicken, size_t count)
+{
+	slots.clear();
+	if (front.empty() || count == 0)
+		return;
+
+	// In front of the bugs, but not past the chicken
+	std::vector<vec2> line = front;
+	for (vec2& point : line)
+	{
+		const vec2 to_chicken = chicken - point;
+		const float distance = length(to_chicken);
+		if (distance > 1e-3f)
+			point += to_chicken * (min(margin, 0.5f * distance) / distance);
+	}
+
+	// Too short for the slots to keep their spacing, stretch it at both ends
+	const float needed = slot_spacing * (count - 1);
+	const float line_length = polyline_length(line);
+	if (line_length < needed)
+	{
+		vec2 start_direction, end_direction;
+		if (line.size() >= 2 && line_length > 1e-3f)
+		{
+			start_direction = normalize(line[0] - line[1]);
+			end_direction = normalize(line.back() - line[line.size() - 2]);
+		}
+		else
+		{
+			const vec2 to_chicken = chicken - line[0];
+			const vec2 across = length(to_chicken) > 1e-3f ? normalize(vec2(-to_chicken.y, to_chicken.x)) : vec2(1.f, 0.f);
+			start_direction = -across;
+			end_direction = across;
+			line.resize(1);
+		}
+		const float extension = 0.5f * (needed - line_length);
+		line.insert(line.begin(), line[0] + start_direction * extension);
+		line.push_back(line.back() + end_direction * extension);
+	}
+
+	// Evenly along the line, a single slot in its middle
+	const float total = polyline_length(line);
+	const float spacing = count > 1 ? total / (count - 1) : 0.f;
+	size_t segment = 0;
+	float segment_start = 0.f;
+	for (size_t s = 0; s < count; s++)
+	{
+		const float at = count > 1 ? s * spacing : 0.5f * total;
+		float segment_length = line.size() > 1 ? length(line[segment + 1] - line[segment]) : 0.f;
+		while (segment + 2 < line.size() && segment_start + segment_length < at)
+		{
+			segment_start += segment_length;
+			segment++;
+			segment_length = length(line[segment + 1] - line[segment]);
+		}
+		if (line.size() == 1 || segment_length < 1e-6f)
+			slots.push_back(line[segment]);
+		else
+			slots.push_back(line[segment] + (line[segment + 1] - line[segment]) * min(1.f, (at - segment_start) / segment_length));
+	}
+}
+
+float Formation::slot_displacement(const std::vector<vec2>& reference) const
+{
+	if (reference.size() != slots.size())
+		return FLT_MAX;
+	float farthest = 0.f;
+	for (size_t s = 0; s < slots.size(); s++)
+		farthest = max(farthest, length(slots[s] - reference[s]));
+	return farthest;
+}
+
+void Formation::update(vec2 chicken, const std::vector<vec2>& bugs, const std::vector<Entity>& members, const std::vector<vec2>& member_positions)
+{
+	if (bugs.empty())
+	{
+		clear();
+		return;
+	}
+	if (hull_is_stale(bugs))
+		build_hull(bugs);
+	find_front(chicken);
+	place_slots(chicken, min((size_t)max_slots, members.size()));
+	if (slots.empty())
+	{
+		member_slot.clear();
+		assigned_ids.clear();
+		assigned_slots.clear();
+		solving = false;
+		return;
+	}
+
+	// The member set in a canonical order
+	member_ids.resize(members.size());
+	order.resize(members.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		Entity member = members[i];
+		member_ids[i] = member;
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return member_ids[a] < member_ids[b]; });
+	ids.resize(members.size());
+	for (size_t i = 0; i < order.size(); i++)
+		ids[i] = member_ids[order[i]];
+
+	const bool assignment_stale = ids != assigned_ids || slot_displacement(assigned_slots) > reassign_distance;
+	// An assignment in progress is finished while the slots move, the next one catches up
+	const bool solving_stale = !solving || ids != solving_ids || slots.size() != solving_slots.size();
+	if (assignment_stale && solving_stale)
+	{
+		// Slots are the rows, members the columns, there are at least as many members
+		const unsigned int rows = (unsigned int)slots.size(), columns = (unsigned int)ids.size();
+		cost.resize((size_t)rows * columns);
+		for (unsigned int s = 0; s < rows; s++)
+			for (unsigned int m = 0; m < columns; m++)
+				cost[s * columns + m] = length(slots[s] - member_positions[order[m]]);
+		solver.begin(rows, columns, cost);
+		solving = true;
+		solving_ids = ids;
+		solving_slots = slots;
+		stats.assignments_started++;
+	}
+
+	if (solving)
+	{
+		const unsigned int rows = (unsigned int)solving_slots.size();
+		const unsigned int assigned_before = solver.get_assigned_rows();
+		const bool done = solver.step(rows_per_step);
+		stats.rows_assigned += solver.get_assigned_rows() - assigned_before;
+		if (done)
+		{
+			member_slot.clear();
+			for (unsigned int s = 0; s < rows; s++)
+				member_slot[solving_ids[solver.get_column(s)]] = s;
+			assigned_ids.swap(solving_ids);
+			assigned_slots.swap(solving_slots);
+			solving = false;
+			stats.assignments_finished++;
+		}
+	}
+}
+
+bool Formation::get_slot(Entity member, vec2& out_position) const
+{
+	auto found = member_slot.find(member);
+	if (found == member_slot.end() || found->second >= slots.size())
+		return false;
+	out_position = slots[found->second];
+	return true;
+}
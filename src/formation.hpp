@@ -0,0 +1,111 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+#include "tiny_ecs.hpp"
+
+// Minimum cost assignment of every row to a distinct column (Hungarian method with
+// potentials). Rows are added to the assignment one at a time, each in O(rows * columns),
+// so a large problem can be solved a few rows per frame.
+class AssignmentSolver
+{
+public:
+	// Starts over with a row-major 'rows' x 'columns' cost matrix, rows <= columns
+	void begin(unsigned int rows, unsigned int columns, const std::vector<float>& cost);
+	// Adds up to 'max_rows' more rows, returns true once all rows are assigned
+	bool step(unsigned int max_rows);
+
+	bool is_done() const { return next_row > rows; }
+	unsigned int get_assigned_rows() const { return next_row - 1; }
+	// Column of a row once done
+	int get_column(unsigned int row) const { return row_column[row]; }
+
+private:
+	unsigned int rows = 0, columns = 0;
+	unsigned int next_row = 1; // rows and columns count from 1 below, 0 is a virtual column
+	std::vector<float> cost;
+	std::vector<float> row_potential, column_potential;
+	std::vector<int> column_row; // row assigned to every column, 0 for none
+	std::vector<int> way; // previous column on the augmenting path
+	std::vector<float> min_slack;
+	std::vector<char> visited;
+	std::vector<int> row_column;
+};
+
+// Counters of a Formation since the last reset_stats()
+struct FormationStats
+{
+	unsigned int hull_rebuilds = 0;
+	unsigned int assignments_started = 0;
+	unsigned int assignments_finished = 0;
+	unsigned int rows_assigned = 0;
+};
+
+// Line of slots between the chicken and the bugs for the eagles holding the frontier.
+// The slots lie along the side of the convex hull of the bugs that faces the chicken,
+// moved 'margin' towards the chicken, and are spread apart to at least 'slot_spacing'.
+//
+// The hull is only rebuilt when bugs come or go or move farther than 'hull_tolerance'
+// since it was built, the slots follow the chicken every update. The slots are assigned
+// to the members with the AssignmentSolver, minimizing the summed distance. A new
+// assignment is started when the members change or the slots moved farther than
+// 'reassign_distance' since the last one, and is solved 'rows_per_step' slots per update.
+// Until it is done, the members keep their slots of the previous assignment. Only a change
+// of the members restarts an assignment in progress.
+class Formation
+{
+public:
+	float margin = 80.f;
+	float slot_spacing = 70.f;
+	unsigned int max_slots = 12;
+	float hull_tolerance = 20.f;
+	float reassign_distance = 60.f;
+	unsigned int rows_per_step = 4;
+
+	// 'member_positions' are those of 'members', there is no formation without bugs or with
+	// the chicken among them
+	void update(vec2 chicken, const std::vector<vec2>& bugs, const std::vector<Entity>& members, const std::vector<vec2>& member_positions);
+	void clear();
+
+	// Current position of the slot of a member, false without one
+	bool get_slot(Entity member, vec2& out_position) const;
+
+	const std::vector<vec2>& get_hull() const { return hull; }
+	const std::vector<vec2>& get_front() const { return front; } // the hull side facing the chicken
+	const std::vector<vec2>& get_slots() const { return slots; }
+	// Slot index of every member by entity id
+	const std::unordered_map<unsigned int, unsigned int>& get_member_slots() const { return member_slot; }
+	const FormationStats& get_stats() const { return stats; }
+	void reset_stats() { stats = FormationStats(); }
+
+private:
+	bool hull_is_stale(const std::vector<vec2>& bugs) const;
+	void build_hull(const std::vector<vec2>& bugs);
+	void find_front(vec2 chicken);
+	void place_slots(vec2 chicken, size_t count);
+	// Farthest any slot moved from 'reference', FLT_MAX if the counts differ
+	float slot_displacement(const std::vector<vec2>& reference) const;
+
+	FormationStats stats;
+	std::vector<vec2> hull_bugs; // bug positions the hull was built from
+	std::vector<vec2> hull;
+	std::vector<vec2> front;
+	std::vector<vec2> slots;
+
+	// Assignment in use, by entity id
+	std::unordered_map<unsigned int, unsigned int> member_slot;
+	std::vector<unsigned int> assigned_ids; // sorted
+	std::vector<vec2> assigned_slots; // where the slots were
+
+	// Assignment being solved
+	AssignmentSolver solver;
+	bool solving = false;
+	std::vector<unsigned int> solving_ids;
+	std::vector<vec2> solving_slots;
+	std::vector<unsigned int> member_ids; // of the members of the current update
+	std::vector<unsigned int> ids; // the same, sorted
+	std::vector<size_t> order; // members sorted by id
+	std::vector<float> cost;
+};
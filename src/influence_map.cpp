@@ -0,0 +1,80 @@
+// internal
+#include "influence_map.hpp"
+#include "simd.hpp"
+
+// stlib
+#include <algorithm>
+
+InfluenceMap::InfluenceMap(vec2 area_size, float cell_size_arg, float decay_ms_arg)
+	: cell_size(cell_size_arg), decay_ms(decay_ms_arg)
+{
+	dims = { max(2, (int)ceil(area_size.x / cell_size)), max(2, (int)ceil(area_size.y / cell_size)) };
+	stride = (dims.x + 3) / 4 * 4;
+	values.assign((size_t)stride * dims.y, 0.f);
+}
+
+void InfluenceMap::decay(float elapsed_ms)
+{
+	const float keep = exp(-elapsed_ms / decay_ms);
+	splat_scale = 1.f - keep;
+	const float4 keep4(keep);
+	float* value = values.data();
+	for (size_t i = 0; i < values.size(); i += 4)
+		(float4::load(value + i) * keep4).store(value + i);
+}
+
+void InfluenceMap::splat(vec2 center, float radius, float strength)
+{
+	const ivec2 cell_min = max(ivec2(0), ivec2(floor((center - radius) / cell_size)));
+	const ivec2 cell_max = min(dims - 1, ivec2(floor((center + radius) / cell_size)));
+	if (cell_min.x > cell_max.x || cell_min.y > cell_max.y)
+		return;
+
+	// Cone of the strength over the cell centers, four cells of a row at a time starting at
+	// a multiple of four. The lanes past cell_max are outside of the cone or in the padding.
+	const float lane_offsets[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+	const float4 lanes = float4::load(lane_offsets) * float4(cell_size);
+	const float4 scaled_strength(strength * splat_scale);
+	const float4 inverse_radius(1.f / radius);
+	const float4 zero(0.f), one(1.f);
+	const int x_begin = cell_min.x / 4 * 4;
+	for (int y = cell_min.y; y <= cell_max.y; y++)
+	{
+		const float dy = (y + 0.5f) * cell_size - center.y;
+		const float4 dy2(dy * dy);
+		float* row = values.data() + (size_t)y * stride;
+		for (int x = x_begin; x <= cell_max.x; x += 4)
+		{
+			const float4 dx = float4(x * cell_size - center.x) + lanes;
+			const float4 distance = sqrt(dx * dx + dy2);
+			const float4 cone = max(zero, one - distance * inverse_radius) * scaled_strength;
+			(float4::load(row + x) + cone).store(row + x);
+		}
+	}
+}
+
+void InfluenceMap::clear()
+{
+	std::fill(values.begin(), values.end(), 0.f);
+}
+
+float InfluenceMap::sample(vec2 position) const
+{
+	// Between the centers of the cells (x, y) and (x + 1, y + 1)
+	const float gx = clamp(position.x / cell_size - 0.5f, 0.f, (float)(dims.x - 1));
+	const float gy = clamp(position.y / cell_size - 0.5f, 0.f, (float)(dims.y - 1));
+	const int x = min((int)gx, dims.x - 2);
+	const int y = min((int)gy, dims.y - 2);
+	const float fx = gx - x, fy = gy - y;
+	const float* row = values.data() + (size_t)y * stride + x;
+	const float top = row[0] + (row[1] - row[0]) * fx;
+	const float bottom = row[stride] + (row[stride + 1] - row[stride]) * fx;
+	return top + (bottom - top) * fy;
+}
+
+vec2 InfluenceMap::gradient(vec2 position) const
+{
+	const float h = 0.5f * cell_size;
+	return vec2(sample(position + vec2(h, 0.f)) - sample(position - vec2(h, 0.f)),
+		sample(position + vec2(0.f, h)) - sample(position - vec2(0.f, h))) / (2.f * h);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+
+// Low resolution grid of how much of something is around, e.g. how dangerous or valuable
+// a place is. Every frame the map fades with decay() and the sources splat() a cone of
+// their strength onto it. A splat adds only the part that faded during the frame, so a
+// source that stays put converges to its strength and a moving one leaves a trail that
+// fades with the time constant of the map. Lookups interpolate between the four nearest
+// cell centers, every query costs the same whatever the number of sources.
+//
+// Rows are padded to a multiple of four cells, so splats and the decay work on four cells
+// at a time with the float4 lanes of simd.hpp.
+class InfluenceMap
+{
+public:
+	InfluenceMap(vec2 area_size = { (float)window_width_px, (float)window_height_px }, float cell_size = 30.f, float decay_ms = 250.f);
+
+	// Fades the map for 'elapsed_ms', the splats until the next call add that much
+	void decay(float elapsed_ms);
+	// Adds strength * (1 - distance / radius) around the center
+	void splat(vec2 center, float radius, float strength);
+	void clear();
+
+	// Interpolated value at a position, positions outside of the grid use the border cells
+	float sample(vec2 position) const;
+	// Per pixel change of the value at a position, pointing uphill
+	vec2 gradient(vec2 position) const;
+
+	// What a splat of a source at distance 'distance' adds to the map after it converged
+	static float falloff(float distance, float radius, float strength) { return strength * max(0.f, 1.f - distance / radius); }
+
+	ivec2 get_dims() const { return dims; }
+	float get_cell_size() const { return cell_size; }
+	float get_cell(int x, int y) const { return values[y * stride + x]; }
+
+private:
+	float cell_size;
+	float decay_ms;
+	ivec2 dims;
+	int stride; // cells per row including the padding
+	float splat_scale = 1.f; // faded fraction of the last decay()
+	std::vector<float> values;
+};
+
+// The maps the AISystem keeps up to date for the decisions of its agents
+struct InfluenceMaps
+{
+	InfluenceMap eagle_guard; // around every eagle blocking a bug
+	InfluenceMap bug_value; // around every bug
+	InfluenceMap chicken_proximity; // around the chicken, close to 1 on it
+};
@@ -0,0 +1,95 @@
+// internal
+#include "job_system.hpp"
+
+// stlib
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned int thread_count)
+	: next_index(0)
+{
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 1; i < thread_count; i++)
+		workers.emplace_back(&JobSystem::worker_loop, this);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	work_ready.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void JobSystem::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& job_arg)
+{
+	if (count == 0)
+		return;
+	grain = std::max<size_t>(grain, 1);
+
+	// Not worth waking anybody up
+	if (workers.empty() || count <= grain)
+	{
+		job_arg(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &job_arg;
+		job_count = count;
+		job_grain = grain;
+		next_index = 0;
+		busy_workers = (unsigned int)workers.size();
+		generation++;
+	}
+	work_ready.notify_all();
+
+	run_chunks();
+
+	// The job object lives on the caller's stack, wait until no worker uses it anymore
+	std::unique_lock<std::mutex> lock(mutex);
+	work_done.wait(lock, [this] { return busy_workers == 0; });
+	job = nullptr;
+}
+
+void JobSystem::run_chunks()
+{
+	while (true)
+	{
+		const size_t begin = next_index.fetch_add(job_grain);
+		if (begin >= job_count)
+			return;
+		(*job)(begin, std::min(begin + job_grain, job_count));
+	}
+}
+
+void JobSystem::worker_loop()
+{
+	unsigned int seen_generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			work_ready.wait(lock, [&] { return stopping || generation != seen_generation; });
+			if (stopping)
+				return;
+			seen_generation = generation;
+		}
+
+		run_chunks();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy_workers == 0)
+			work_done.notify_one();
+	}
+}
+
+JobSystem& get_job_system()
+{
+	static JobSystem job_system;
+	return job_system;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small pool of worker threads for data parallel loops. parallel_for splits an index
+// range into chunks that the workers and the calling thread pull from a shared counter,
+// so uneven chunks (e.g., islands of different sizes) balance themselves. One loop runs
+// at a time and jobs must not call parallel_for themselves.
+class JobSystem
+{
+public:
+	// thread_count includes the calling thread, 0 uses one thread per hardware thread
+	explicit JobSystem(unsigned int thread_count = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Calls job(begin, end) for consecutive ranges of at most 'grain' indices covering
+	// [0, count) and returns once all of them are done
+	void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& job);
+
+	unsigned int get_thread_count() const { return (unsigned int)workers.size() + 1; }
+
+private:
+	void worker_loop();
+	// Pulls chunks of the current loop until none are left
+	void run_chunks();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable work_ready;
+	std::condition_variable work_done;
+
+	// the current loop, guarded by 'mutex' except for the chunk counter
+	const std::function<void(size_t, size_t)>* job = nullptr;
+	size_t job_count = 0;
+	size_t job_grain = 1;
+	std::atomic<size_t> next_index;
+	unsigned int generation = 0;
+	unsigned int busy_workers = 0;
+	bool stopping = false;
+};
+
+// Pool shared by the systems, created on first use
+JobSystem& get_job_system();
@@ -3,12 +3,15 @@
 #include <gl3w.h>
 
 // stlib
+#include <algorithm>
 #include <chrono>
 
 // internal
 #include "ai_system.hpp"
+#include "benchmarks.hpp"
 #include "physics_system.hpp"
 #include "render_system.hpp"
+#include "wind_system.hpp"
 #include "world_system.hpp"
 
 using Clock = std::chrono::high_resolution_clock;
@@ -17,14 +20,27 @@ struct Mode
 	bool basic = true;
 	bool advance = false;
 };
+
+// Fixed timestep configuration, the simulation always advances in ticks of 1000 / tick_hz ms
+struct FixedTimestep
+{
+	float tick_hz = 60.f;
+	// Upper bound on ticks simulated per frame, the remainder of a longer hitch is dropped
+	int max_catch_up_steps = 5;
+};
 // Entry point
-int main()
+int main(int argc, char* argv[])
 {
+	// Headless benchmarks, e.g. `chicken --benchmark all`
+	if (argc >= 3 && std::string(argv[1]) == "--benchmark")
+		return run_benchmark(argv[2]);
+
 	// Global systems
 	WorldSystem world;
 	RenderSystem renderer;
 	PhysicsSystem physics;
 	AISystem ai;
+	WindSystem wind;
 
 	// Initializing window
 	GLFWwindow* window = world.create_window();
@@ -37,9 +53,15 @@ int main()
 
 	// initialize the main systems
 	renderer.init(window);
-	world.init(&renderer);
+	world.init(&renderer, &wind);
+	ai.init(&physics);
+	// A bug the chicken touches while it is lit up is eaten once the light goes out
+	physics.stay_event_layers = LAYER_EATABLE;
 
-	// variable timestep loop
+	// fixed timestep loop, the renderer interpolates between the last two ticks
+	FixedTimestep timestep;
+	const float tick_ms = 1000.f / timestep.tick_hz;
+	float accumulator_ms = 0.f;
 	auto t = Clock::now();
 	while (!world.is_over()) {
 		// Processes system messages, if this wasn't present the window would become unresponsive
@@ -51,12 +73,19 @@ int main()
 			(float)(std::chrono::duration_cast<std::chrono::microseconds>(now - t)).count() / 1000;
 		t = now;
 
-		world.step(elapsed_ms);
-		ai.step(elapsed_ms);
-		physics.step(elapsed_ms);
-		world.handle_collisions();
+		// Clamp the backlog so that a hitch doesn't spiral into ever more catch-up ticks
+		accumulator_ms = std::min(accumulator_ms + elapsed_ms, timestep.max_catch_up_steps * tick_ms);
+		while (accumulator_ms >= tick_ms) {
+			physics.store_previous_motions();
+			world.step(tick_ms);
+			ai.step(tick_ms);
+			wind.step(tick_ms);
+			physics.step(tick_ms);
+			world.handle_collisions();
+			accumulator_ms -= tick_ms;
+		}
 
-		renderer.draw();
+		renderer.draw(accumulator_ms / tick_ms);
 
 		// TODO A2: you can implement the debug freeze here but other places are possible too.
 	}
@@ -0,0 +1,149 @@
+// internal
+#include "mesh_bvh.hpp"
+
+// stlib
+#include <algorithm>
+#include <cfloat>
+
+// Maximum number of triangles stored in a leaf
+const unsigned int BVH_LEAF_SIZE = 4;
+
+// Projects the polygon onto the axis and returns the covered interval
+static void project(const vec2* polygon, int count, vec2 axis, float& out_min, float& out_max)
+{
+	out_min = out_max = dot(polygon[0], axis);
+	for (int i = 1; i < count; i++)
+	{
+		float d = dot(polygon[i], axis);
+		out_min = min(out_min, d);
+		out_max = max(out_max, d);
+	}
+}
+
+// Returns true if one of the edge normals of 'polygon' separates the two polygons
+static bool has_separating_axis(const vec2* polygon, int count, const vec2* other, int other_count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		vec2 edge = polygon[(i + 1) % count] - polygon[i];
+		vec2 axis = { -edge.y, edge.x };
+		float min_a, max_a, min_b, max_b;
+		project(polygon, count, axis, min_a, max_a);
+		project(other, other_count, axis, min_b, max_b);
+		if (max_a < min_b || max_b < min_a)
+			return true;
+	}
+	return false;
+}
+
+bool convex_polygons_overlap(const vec2* a, int a_count, const vec2* b, int b_count)
+{
+	return !has_separating_axis(a, a_count, b, b_count) && !has_separating_axis(b, b_count, a, a_count);
+}
+
+void MeshBVH::build(const Mesh& mesh)
+{
+	nodes.clear();
+	triangles.clear();
+	for (size_t i = 0; i + 2 < mesh.vertex_indices.size(); i += 3)
+	{
+		Triangle triangle;
+		for (size_t k = 0; k < 3; k++)
+			triangle.corners[k] = vec2(mesh.vertices[mesh.vertex_indices[i + k]].position);
+		triangles.push_back(triangle);
+	}
+
+	unsigned int triangle_count = (unsigned int)triangles.size();
+	if (triangle_count == 0)
+		return;
+	// a binary tree with leaves of at least one triangle has less than 2n nodes
+	nodes.reserve(2 * triangle_count);
+	nodes.push_back({});
+	build_node(0, 0, triangle_count);
+}
+
+void MeshBVH::build_node(unsigned int node_index, unsigned int first, unsigned int count)
+{
+	vec2 node_min = triangles[first].corners[0];
+	vec2 node_max = node_min;
+	vec2 centroid_min = { FLT_MAX, FLT_MAX };
+	vec2 centroid_max = { -FLT_MAX, -FLT_MAX };
+	for (unsigned int t = first; t < first + count; t++)
+	{
+		vec2 centroid = { 0, 0 };
+		for (const vec2& corner : triangles[t].corners)
+		{
+			node_min = min(node_min, corner);
+			node_max = max(node_max, corner);
+			centroid += corner / 3.f;
+		}
+		centroid_min = min(centroid_min, centroid);
+		centroid_max = max(centroid_max, centroid);
+	}
+	nodes[node_index].min = node_min;
+	nodes[node_index].max = node_max;
+
+	if (count <= BVH_LEAF_SIZE)
+	{
+		nodes[node_index].first = first;
+		nodes[node_index].count = count;
+		return;
+	}
+
+	// Split at the median centroid along the longer axis of the centroid bounds
+	vec2 extent = centroid_max - centroid_min;
+	int axis = extent.x > extent.y ? 0 : 1;
+	auto begin = triangles.begin() + first;
+	std::nth_element(begin, begin + count / 2, begin + count, [axis](const Triangle& a, const Triangle& b) {
+		return a.corners[0][axis] + a.corners[1][axis] + a.corners[2][axis] <
+			b.corners[0][axis] + b.corners[1][axis] + b.corners[2][axis];
+	});
+
+	// Both children are allocated next to each other before descending
+	unsigned int left = (unsigned int)nodes.size();
+	nodes[node_index].first = left;
+	nodes[node_index].count = 0;
+	nodes.push_back({});
+	nodes.push_back({});
+	build_node(left, first, count / 2);
+	build_node(left + 1, first + count / 2, count - count / 2);
+}
+
+bool MeshBVH::intersects(const vec2* polygon, int count) const
+{
+	if (nodes.empty())
+		return false;
+
+	vec2 polygon_min = polygon[0];
+	vec2 polygon_max = polygon[0];
+	for (int i = 1; i < count; i++)
+	{
+		polygon_min = min(polygon_min, polygon[i]);
+		polygon_max = max(polygon_max, polygon[i]);
+	}
+
+	// Iterative traversal, the tree depth is logarithmic in the triangle count
+	unsigned int stack[64];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+	while (stack_size > 0)
+	{
+		const Node& node = nodes[stack[--stack_size]];
+		if (node.max.x < polygon_min.x || polygon_max.x < node.min.x ||
+			node.max.y < polygon_min.y || polygon_max.y < node.min.y)
+			continue;
+
+		if (node.count > 0)
+		{
+			for (unsigned int t = node.first; t < node.first + node.count; t++)
+				if (convex_polygons_overlap(triangles[t].corners, 3, polygon, count))
+					return true;
+		}
+		else
+		{
+			stack[stack_size++] = node.first;
+			stack[stack_size++] = node.first + 1;
+		}
+	}
+	return false;
+}
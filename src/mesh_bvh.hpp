@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "components.hpp"
+
+// Returns true if the two convex polygons overlap (separating axis test).
+// Works for any winding order, the polygons only need to be convex.
+bool convex_polygons_overlap(const vec2* a, int a_count, const vec2* b, int b_count);
+
+// Bounding volume hierarchy over the triangles of a Mesh, built once per mesh in the
+// mesh's local (normalized) coordinates so that it can be shared by all entities using it
+class MeshBVH
+{
+public:
+	// Builds the hierarchy from the xy projection of the mesh triangles
+	void build(const Mesh& mesh);
+
+	// Returns true if any triangle intersects the convex polygon given in local mesh coordinates
+	bool intersects(const vec2* polygon, int count) const;
+
+	bool empty() const { return nodes.empty(); }
+
+private:
+	struct Node
+	{
+		vec2 min;
+		vec2 max;
+		// leaves: first triangle and triangle count, inner nodes: index of the left
+		// child (the right child directly follows it) and a count of 0
+		unsigned int first;
+		unsigned int count;
+	};
+
+	struct Triangle
+	{
+		vec2 corners[3];
+	};
+
+	void build_node(unsigned int node_index, unsigned int first, unsigned int count);
+
+	std::vector<Node> nodes;
+	// reordered so that every leaf covers a contiguous range
+	std::vector<Triangle> triangles;
+};
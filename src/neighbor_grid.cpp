@@ -0,0 +1,50 @@
+// internal
+#include "neighbor_grid.hpp"
+
+// stlib
+#include <algorithm>
+#include <cfloat>
+
+// Upper bound of the cells per axis
+const int NEIGHBOR_GRID_MAX_DIM = 512;
+
+void NeighborGrid::build(const float* x, const float* y, unsigned int count, float cell_size, const char* used)
+{
+	vec2 area_min = { FLT_MAX, FLT_MAX }, area_max = { -FLT_MAX, -FLT_MAX };
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (used != nullptr && !used[i])
+			continue;
+		area_min = min(area_min, vec2(x[i], y[i]));
+		area_max = max(area_max, vec2(x[i], y[i]));
+	}
+	if (area_min.x > area_max.x)
+	{
+		dims = { 0, 0 };
+		entries.clear();
+		return;
+	}
+	const vec2 extent = area_max - area_min;
+	cell_size = max(cell_size, max(extent.x, extent.y) / (float)NEIGHBOR_GRID_MAX_DIM);
+	origin = area_min;
+	inverse_cell_size = 1.f / cell_size;
+	dims = { (int)(extent.x * inverse_cell_size) + 1, (int)(extent.y * inverse_cell_size) + 1 };
+
+	// Counting sort by cell
+	cell_start.assign((size_t)dims.x * dims.y + 1, 0);
+	cell_of.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (used != nullptr && !used[i])
+			continue;
+		cell_of[i] = get_cell_y(y[i]) * dims.x + get_cell_x(x[i]);
+		cell_start[cell_of[i] + 1]++;
+	}
+	for (size_t c = 1; c < cell_start.size(); c++)
+		cell_start[c] += cell_start[c - 1];
+	entries.resize(cell_start.back());
+	fill.assign(cell_start.begin(), cell_start.end() - 1);
+	for (unsigned int i = 0; i < count; i++)
+		if (used == nullptr || used[i])
+			entries[fill[cell_of[i]]++] = i;
+}
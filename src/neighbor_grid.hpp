@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+
+// Uniform grid over a set of points for radius queries between AI agents. The points are
+// binned with a counting sort every build, so a rebuild is two linear passes that allocate
+// nothing once the buffers have grown, and the points of a cell are contiguous in memory.
+// The grid covers the bounding box of the points, its cell count is capped so that a few
+// far away points can't blow it up.
+class NeighborGrid
+{
+public:
+	// Bins 'count' points given as separate x and y arrays into cells of (at least)
+	// cell_size, points whose 'used' entry is 0 are left out if 'used' is given
+	void build(const float* x, const float* y, unsigned int count, float cell_size, const char* used = nullptr);
+
+	// Calls visit(index) for every point in the cells covered by the circle, the caller
+	// checks the actual distance
+	template <class Visitor>
+	void for_each_near(vec2 position, float radius, Visitor visit) const;
+
+	// Point indices ordered by cell
+	const std::vector<unsigned int>& get_sorted() const { return entries; }
+	ivec2 get_dims() const { return dims; }
+
+private:
+	int get_cell_x(float x) const { return max(0, min(dims.x - 1, (int)((x - origin.x) * inverse_cell_size))); }
+	int get_cell_y(float y) const { return max(0, min(dims.y - 1, (int)((y - origin.y) * inverse_cell_size))); }
+
+	vec2 origin = { 0, 0 };
+	float inverse_cell_size = 1.f;
+	ivec2 dims = { 0, 0 };
+
+	// prefix sums of the cell occupancy, cell c holds entries[cell_start[c] .. cell_start[c+1])
+	std::vector<unsigned int> cell_start;
+	std::vector<unsigned int> cell_of;
+	std::vector<unsigned int> entries;
+	std::vector<unsigned int> fill;
+};
+
+template <class Visitor>
+void NeighborGrid::for_each_near(vec2 position, float radius, Visitor visit) const
+{
+	if (dims.x == 0)
+		return;
+	const int x_begin = get_cell_x(position.x - radius), x_end = get_cell_x(position.x + radius);
+	const int y_begin = get_cell_y(position.y - radius), y_end = get_cell_y(position.y + radius);
+	for (int y = y_begin; y <= y_end; y++)
+	{
+		// the cells of a row are contiguous, so are their entries
+		const unsigned int begin = cell_start[y * dims.x + x_begin];
+		const unsigned int end = cell_start[y * dims.x + x_end + 1];
+		for (unsigned int e = begin; e < end; e++)
+			visit(entries[e]);
+	}
+}
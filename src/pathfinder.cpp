@@ -0,0 +1,641 @@
+// internal
+#include "pathfinder.hpp"
+
+// stlib
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+
+const float SQRT2 = 1.41421356f;
+// Paths shorter than this many clusters skip the abstraction
+const float DIRECT_SEARCH_CLUSTERS = 2.f;
+// Border runs of free cells at least this long get an entrance at both ends, shorter
+// ones a single one in the middle
+const int LONG_ENTRANCE = 6;
+// How far a blocked start or goal cell is moved to find a free one, in cells
+const int FREE_CELL_SEARCH_RADIUS = 3;
+
+static const auto heap_order = std::greater<std::pair<float, int>>();
+
+Pathfinder::Pathfinder(vec2 area_size, float cell_size_arg, int cluster_size_arg)
+	: cell_size(cell_size_arg), cluster_size(cluster_size_arg)
+{
+	dims = { (int)ceil(area_size.x / cell_size), (int)ceil(area_size.y / cell_size) };
+	cluster_dims = { (dims.x + cluster_size - 1) / cluster_size, (dims.y + cluster_size - 1) / cluster_size };
+	const size_t cell_count = (size_t)dims.x * dims.y;
+	blocked.assign(cell_count, 0);
+	next_blocked.assign(cell_count, 0);
+	g.assign(cell_count, 0.f);
+	parent.assign(cell_count, -1);
+	seen.assign(cell_count, 0);
+	closed.assign(cell_count, 0);
+
+	clusters.resize((size_t)cluster_dims.x * cluster_dims.y);
+	for (int cy = 0; cy < cluster_dims.y; cy++)
+	{
+		for (int cx = 0; cx < cluster_dims.x; cx++)
+		{
+			Cluster& cluster = clusters[cy * cluster_dims.x + cx];
+			cluster.min = ivec2(cx, cy) * cluster_size;
+			cluster.max = min(cluster.min + cluster_size, dims);
+		}
+	}
+	for (int c = 0; c < (int)clusters.size(); c++)
+		build_cluster(c);
+	build_node_index();
+}
+
+int Pathfinder::get_cell(vec2 position) const
+{
+	const int x = max(0, min(dims.x - 1, (int)floor(position.x / cell_size)));
+	const int y = max(0, min(dims.y - 1, (int)floor(position.y / cell_size)));
+	return y * dims.x + x;
+}
+
+float Pathfinder::octile(int a, int b) const
+{
+	const int dx = abs(a % dims.x - b % dims.x);
+	const int dy = abs(a / dims.x - b / dims.x);
+	return (float)max(dx, dy) + (SQRT2 - 1.f) * (float)min(dx, dy);
+}
+
+int Pathfinder::find_free_cell(int cell) const
+{
+	if (!blocked[cell])
+		return cell;
+	const int x = cell % dims.x, y = cell / dims.x;
+	int best = -1;
+	float best_distance = FLT_MAX;
+	for (int dy = -FREE_CELL_SEARCH_RADIUS; dy <= FREE_CELL_SEARCH_RADIUS; dy++)
+	{
+		for (int dx = -FREE_CELL_SEARCH_RADIUS; dx <= FREE_CELL_SEARCH_RADIUS; dx++)
+		{
+			if (!walkable(x + dx, y + dy))
+				continue;
+			const float distance = (float)(dx * dx + dy * dy);
+			if (distance < best_distance)
+			{
+				best_distance = distance;
+				best = (y + dy) * dims.x + x + dx;
+			}
+		}
+	}
+	return best;
+}
+
+void Pathfinder::begin_obstacles()
+{
+	std::fill(next_blocked.begin(), next_blocked.end(), 0);
+}
+
+void Pathfinder::add_obstacle(vec2 center, float radius)
+{
+	const ivec2 cell_min = max(ivec2(0), ivec2(floor((center - radius) / cell_size)));
+	const ivec2 cell_max = min(dims - 1, ivec2(floor((center + radius) / cell_size)));
+	for (int y = cell_min.y; y <= cell_max.y; y++)
+	{
+		for (int x = cell_min.x; x <= cell_max.x; x++)
+		{
+			const vec2 cell_low = vec2(x, y) * cell_size;
+			const vec2 closest = clamp(center, cell_low, cell_low + cell_size);
+			const vec2 d = closest - center;
+			if (dot(d, d) <= radius * radius)
+				next_blocked[y * dims.x + x] = 1;
+		}
+	}
+}
+
+bool Pathfinder::end_obstacles()
+{
+	// Clusters next to a changed cell have to be rebuilt, the entrances on their shared
+	// border depend on both sides
+	dirty.assign(clusters.size(), 0);
+	bool changed = false;
+	for (int cell = 0; cell < (int)blocked.size(); cell++)
+	{
+		if (blocked[cell] == next_blocked[cell])
+			continue;
+		changed = true;
+		const int cx = (cell % dims.x) / cluster_size, cy = (cell / dims.x) / cluster_size;
+		for (int k = -1; k <= 1; k++)
+		{
+			if (cx + k >= 0 && cx + k < cluster_dims.x)
+				dirty[cy * cluster_dims.x + cx + k] = 1;
+			if (cy + k >= 0 && cy + k < cluster_dims.y)
+				dirty[(cy + k) * cluster_dims.x + cx] = 1;
+		}
+	}
+	if (!changed)
+		return false;
+
+	blocked.swap(next_blocked);
+	for (int c = 0; c < (int)clusters.size(); c++)
+	{
+		if (dirty[c])
+		{
+			build_cluster(c);
+			stats.dirty_clusters++;
+		}
+	}
+	build_node_index();
+	stats.obstacle_updates++;
+	version++;
+	revalidate_cache(version - 1);
+	return true;
+}
+
+void Pathfinder::build_cluster(int cluster_index)
+{
+	Cluster& cluster = clusters[cluster_index];
+	cluster.entrances.clear();
+	cluster.partners.clear();
+
+	// Each side is scanned the same way from both clusters, so the entrances of
+	// neighboring clusters always come in pairs
+	struct Side
+	{
+		ivec2 first; // first cell of the side inside the cluster
+		ivec2 along;
+		ivec2 across; // towards the neighbor
+		int length;
+	};
+	const ivec2 size = cluster.max - cluster.min;
+	const Side sides[4] = {
+		{ cluster.min, { 0, 1 }, { -1, 0 }, size.y },
+		{ { cluster.max.x - 1, cluster.min.y }, { 0, 1 }, { 1, 0 }, size.y },
+		{ cluster.min, { 1, 0 }, { 0, -1 }, size.x },
+		{ { cluster.min.x, cluster.max.y - 1 }, { 1, 0 }, { 0, 1 }, size.x },
+	};
+	for (const Side& side : sides)
+	{
+		int run_start = -1;
+		for (int i = 0; i <= side.length; i++)
+		{
+			const ivec2 inside = side.first + side.along * i;
+			const ivec2 outside = inside + side.across;
+			const bool open = i < side.length && walkable(inside.x, inside.y) && walkable(outside.x, outside.y);
+			if (open && run_start < 0)
+				run_start = i;
+			if (open || run_start < 0)
+				continue;
+			// the run [run_start, i) ended
+			const int run_length = i - run_start;
+			const int picks[2] = { run_length >= LONG_ENTRANCE ? run_start : run_start + run_length / 2, i - 1 };
+			for (int k = 0; k < (run_length >= LONG_ENTRANCE ? 2 : 1); k++)
+			{
+				const ivec2 cell = side.first + side.along * picks[k];
+				const ivec2 partner = cell + side.across;
+				cluster.entrances.push_back(cell.y * dims.x + cell.x);
+				cluster.partners.push_back(partner.y * dims.x + partner.x);
+			}
+			run_start = -1;
+		}
+	}
+
+	// Distances between the entrances within the cluster
+	const size_t count = cluster.entrances.size();
+	cluster.distances.assign(count * count, FLT_MAX);
+	for (size_t a = 0; a < count; a++)
+	{
+		cluster_dijkstra(cluster_index, cluster.entrances[a], local_distances);
+		for (size_t b = 0; b < count; b++)
+		{
+			const int cell = cluster.entrances[b];
+			const int local = (cell / dims.x - cluster.min.y) * cluster_size + cell % dims.x - cluster.min.x;
+			cluster.distances[a * count + b] = local_distances[local];
+		}
+	}
+}
+
+void Pathfinder::cluster_dijkstra(int cluster_index, int from, std::vector<float>& out_distances)
+{
+	// Over the cells of one cluster, indexed locally by row of cluster_size
+	const Cluster& cluster = clusters[cluster_index];
+	out_distances.assign((size_t)cluster_size * cluster_size, FLT_MAX);
+	auto local_index = [&](int x, int y) { return (y - cluster.min.y) * cluster_size + x - cluster.min.x; };
+	auto inside = [&](int x, int y) {
+		return x >= cluster.min.x && y >= cluster.min.y && x < cluster.max.x && y < cluster.max.y && !blocked[y * dims.x + x];
+	};
+
+	open.clear();
+	out_distances[local_index(from % dims.x, from / dims.x)] = 0.f;
+	open.push_back({ 0.f, from });
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), heap_order);
+		const std::pair<float, int> top = open.back();
+		open.pop_back();
+		const int x = top.second % dims.x, y = top.second / dims.x;
+		if (top.first > out_distances[local_index(x, y)])
+			continue;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if ((dx == 0 && dy == 0) || !inside(x + dx, y + dy))
+					continue;
+				if (dx != 0 && dy != 0 && (!inside(x + dx, y) || !inside(x, y + dy)))
+					continue;
+				const float distance = top.first + (dx != 0 && dy != 0 ? SQRT2 : 1.f);
+				float& best = out_distances[local_index(x + dx, y + dy)];
+				if (distance < best)
+				{
+					best = distance;
+					open.push_back({ distance, (y + dy) * dims.x + x + dx });
+					std::push_heap(open.begin(), open.end(), heap_order);
+				}
+			}
+		}
+	}
+}
+
+void Pathfinder::build_node_index()
+{
+	cluster_first_node.resize(clusters.size() + 1);
+	cluster_first_node[0] = 0;
+	for (size_t c = 0; c < clusters.size(); c++)
+		cluster_first_node[c + 1] = cluster_first_node[c] + (int)clusters[c].entrances.size();
+	node_of_cell.assign(blocked.size(), -1);
+	for (size_t c = 0; c < clusters.size(); c++)
+		for (size_t k = 0; k < clusters[c].entrances.size(); k++)
+			node_of_cell[clusters[c].entrances[k]] = cluster_first_node[c] + (int)k;
+}
+
+int Pathfinder::jump(int x, int y, int dx, int dy, int goal) const
+{
+	// Walks in one direction until the goal, a cell with a forced neighbor or (diagonally)
+	// a cell from which a straight jump finds one
+	while (true)
+	{
+		if (!passable(x, y))
+			return -1;
+		const int cell = y * dims.x + x;
+		if (cell == goal)
+			return cell;
+		if (dx != 0 && dy != 0)
+		{
+			if (jump(x + dx, y, dx, 0, goal) >= 0 || jump(x, y + dy, 0, dy, goal) >= 0)
+				return cell;
+		}
+		else if (dx != 0)
+		{
+			if ((passable(x, y - 1) && !passable(x - dx, y - 1)) || (passable(x, y + 1) && !passable(x - dx, y + 1)))
+				return cell;
+		}
+		else
+		{
+			if ((passable(x - 1, y) && !passable(x - 1, y - dy)) || (passable(x + 1, y) && !passable(x + 1, y - dy)))
+				return cell;
+		}
+		// diagonal steps need both cells beside them free
+		if (!passable(x + dx, y) || !passable(x, y + dy))
+			return -1;
+		x += dx;
+		y += dy;
+	}
+}
+
+bool Pathfinder::jump_point_search(int start, int goal, std::vector<int>& out_cells, ivec2 bounds_min, ivec2 bounds_max)
+{
+	stats.jump_point_searches++;
+	search_min = bounds_min;
+	search_max = bounds_max;
+	if (start == goal)
+		return true;
+	const unsigned int stamp = ++search_stamp;
+	open.clear();
+	g[start] = 0.f;
+	parent[start] = -1;
+	seen[start] = stamp;
+	open.push_back({ octile(start, goal), start });
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), heap_order);
+		const int cell = open.back().second;
+		open.pop_back();
+		if (closed[cell] == stamp)
+			continue;
+		closed[cell] = stamp;
+		if (cell == goal)
+		{
+			const size_t first = out_cells.size();
+			for (int c = goal; c != start; c = parent[c])
+				out_cells.push_back(c);
+			std::reverse(out_cells.begin() + first, out_cells.end());
+			return true;
+		}
+
+		// Pruned neighbors, all of them at the start
+		const int x = cell % dims.x, y = cell / dims.x;
+		ivec2 directions[8];
+		int direction_count = 0;
+		if (parent[cell] < 0)
+		{
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dx = -1; dx <= 1; dx++)
+					if (dx != 0 || dy != 0)
+						directions[direction_count++] = { dx, dy };
+		}
+		else
+		{
+			const int px = parent[cell] % dims.x, py = parent[cell] / dims.x;
+			const int dx = (x > px) - (x < px), dy = (y > py) - (y < py);
+			if (dx != 0 && dy != 0)
+			{
+				directions[direction_count++] = { 0, dy };
+				directions[direction_count++] = { dx, 0 };
+				directions[direction_count++] = { dx, dy };
+			}
+			else if (dx != 0)
+			{
+				directions[direction_count++] = { dx, 0 };
+				directions[direction_count++] = { dx, 1 };
+				directions[direction_count++] = { dx, -1 };
+				directions[direction_count++] = { 0, 1 };
+				directions[direction_count++] = { 0, -1 };
+			}
+			else
+			{
+				directions[direction_count++] = { 0, dy };
+				directions[direction_count++] = { 1, dy };
+				directions[direction_count++] = { -1, dy };
+				directions[direction_count++] = { 1, 0 };
+				directions[direction_count++] = { -1, 0 };
+			}
+		}
+
+		for (int k = 0; k < direction_count; k++)
+		{
+			const ivec2 d = directions[k];
+			if (d.x != 0 && d.y != 0 && (!passable(x + d.x, y) || !passable(x, y + d.y)))
+				continue;
+			const int jump_point = jump(x + d.x, y + d.y, d.x, d.y, goal);
+			if (jump_point < 0 || closed[jump_point] == stamp)
+				continue;
+			const float cost = g[cell] + octile(cell, jump_point);
+			if (seen[jump_point] != stamp || cost < g[jump_point])
+			{
+				seen[jump_point] = stamp;
+				g[jump_point] = cost;
+				parent[jump_point] = cell;
+				open.push_back({ cost + octile(jump_point, goal), jump_point });
+				std::push_heap(open.begin(), open.end(), heap_order);
+			}
+		}
+	}
+	return false;
+}
+
+bool Pathfinder::abstract_search(int start, int goal, std::vector<int>& out_cells)
+{
+	stats.abstract_searches++;
+	const int start_cluster = cluster_of(start);
+	const int goal_cluster = cluster_of(goal);
+	const Cluster& first = clusters[start_cluster];
+
+	// Links of the start and the goal to the entrances of their clusters
+	auto link = [&](int cluster_index, int cell, std::vector<float>& out_links) {
+		const Cluster& cluster = clusters[cluster_index];
+		cluster_dijkstra(cluster_index, cell, local_distances);
+		out_links.resize(cluster.entrances.size());
+		for (size_t k = 0; k < cluster.entrances.size(); k++)
+		{
+			const int entrance = cluster.entrances[k];
+			out_links[k] = local_distances[(entrance / dims.x - cluster.min.y) * cluster_size + entrance % dims.x - cluster.min.x];
+		}
+	};
+	link(start_cluster, start, start_links);
+	link(goal_cluster, goal, goal_links);
+
+	// A* over the entrance nodes, the start node is node_count and the goal node_count + 1.
+	// The search state is indexed by node here, the cell arrays are large enough.
+	const int node_count = cluster_first_node.back();
+	const int start_node = node_count, goal_node = node_count + 1;
+	auto node_cell = [&](int node) {
+		if (node == start_node)
+			return start;
+		if (node == goal_node)
+			return goal;
+		const int cluster = (int)(std::upper_bound(cluster_first_node.begin(), cluster_first_node.end(), node) - cluster_first_node.begin()) - 1;
+		return clusters[cluster].entrances[node - cluster_first_node[cluster]];
+	};
+	if ((size_t)node_count + 2 > g.size())
+		return false;
+
+	const unsigned int stamp = ++search_stamp;
+	open.clear();
+	auto relax = [&](int from, int to, float cost) {
+		if (cost == FLT_MAX || closed[to] == stamp)
+			return;
+		const float total = g[from] + cost;
+		if (seen[to] != stamp || total < g[to])
+		{
+			seen[to] = stamp;
+			g[to] = total;
+			parent[to] = from;
+			open.push_back({ total + octile(node_cell(to), goal), to });
+			std::push_heap(open.begin(), open.end(), heap_order);
+		}
+	};
+	g[start_node] = 0.f;
+	parent[start_node] = -1;
+	seen[start_node] = stamp;
+	open.push_back({ octile(start, goal), start_node });
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), heap_order);
+		const int node = open.back().second;
+		open.pop_back();
+		if (closed[node] == stamp)
+			continue;
+		closed[node] = stamp;
+		if (node == goal_node)
+			break;
+		if (node == start_node)
+		{
+			for (size_t k = 0; k < first.entrances.size(); k++)
+				relax(node, cluster_first_node[start_cluster] + (int)k, start_links[k]);
+			continue;
+		}
+		const int cluster_index = (int)(std::upper_bound(cluster_first_node.begin(), cluster_first_node.end(), node) - cluster_first_node.begin()) - 1;
+		const Cluster& cluster = clusters[cluster_index];
+		const size_t k = node - cluster_first_node[cluster_index];
+		const size_t count = cluster.entrances.size();
+		for (size_t j = 0; j < count; j++)
+			if (j != k)
+				relax(node, cluster_first_node[cluster_index] + (int)j, cluster.distances[k * count + j]);
+		const int across = node_of_cell[cluster.partners[k]];
+		if (across >= 0)
+			relax(node, across, 1.f);
+		if (cluster_index == goal_cluster)
+			relax(node, goal_node, goal_links[k]);
+	}
+	if (closed[goal_node] != stamp)
+		return false;
+
+	// Refine the abstract path. Legs within a cluster are searched within it, where their
+	// distance came from, steps across a border are a single move.
+	scratch_cells.clear();
+	for (int node = goal_node; node != start_node; node = parent[node])
+		scratch_cells.push_back(node_cell(node));
+	std::reverse(scratch_cells.begin(), scratch_cells.end());
+	int from = start;
+	for (int to : scratch_cells)
+	{
+		const Cluster& cluster = clusters[cluster_of(from)];
+		if (cluster_of(to) != cluster_of(from))
+			out_cells.push_back(to);
+		else if (!jump_point_search(from, to, out_cells, cluster.min, cluster.max))
+			return false;
+		from = to;
+	}
+	return true;
+}
+
+bool Pathfinder::search(int start, int goal, std::vector<int>& out_cells)
+{
+	out_cells.clear();
+	out_cells.push_back(start);
+	if (octile(start, goal) < DIRECT_SEARCH_CLUSTERS * cluster_size)
+		return jump_point_search(start, goal, out_cells, ivec2(0), dims);
+	return abstract_search(start, goal, out_cells);
+}
+
+bool Pathfinder::find_path(vec2 start_position, vec2 goal_position, std::vector<vec2>& out_waypoints)
+{
+	stats.queries++;
+	out_waypoints.clear();
+	const CacheKey key = { get_cell(start_position), get_cell(goal_position), version };
+	auto it = cache.find(key);
+	if (it != cache.end() && it->second->stale)
+	{
+		const auto entry = it->second;
+		if (repair_path(entry->cells))
+		{
+			entry->stale = false;
+			stats.repaired_paths++;
+		}
+		else
+		{
+			stats.dropped_paths++;
+			lru.erase(entry);
+			cache.erase(it);
+			it = cache.end();
+		}
+	}
+	if (it == cache.end())
+	{
+		const int start = find_free_cell(key.start);
+		const int goal = find_free_cell(key.goal);
+		std::vector<int> cells;
+		if (start < 0 || goal < 0 || !search(start, goal, cells))
+			return false;
+		if (cache.size() >= cache_capacity && !lru.empty())
+		{
+			cache.erase(lru.back().key);
+			lru.pop_back();
+		}
+		lru.push_front({ key, std::move(cells), false });
+		it = cache.emplace(key, lru.begin()).first;
+	}
+	else
+	{
+		stats.cache_hits++;
+		lru.splice(lru.begin(), lru, it->second);
+	}
+
+	for (int cell : it->second->cells)
+		out_waypoints.push_back({ (cell % dims.x + 0.5f) * cell_size, (cell / dims.x + 0.5f) * cell_size });
+	return true;
+}
+
+bool Pathfinder::find_path_direct(vec2 start_position, vec2 goal_position, std::vector<vec2>& out_waypoints)
+{
+	out_waypoints.clear();
+	const int start = find_free_cell(get_cell(start_position));
+	const int goal = find_free_cell(get_cell(goal_position));
+	scratch_cells.clear();
+	scratch_cells.push_back(start);
+	if (start < 0 || goal < 0 || !jump_point_search(start, goal, scratch_cells, ivec2(0), dims))
+		return false;
+	for (int cell : scratch_cells)
+		out_waypoints.push_back({ (cell % dims.x + 0.5f) * cell_size, (cell / dims.x + 0.5f) * cell_size });
+	return true;
+}
+
+bool Pathfinder::find_blocked_segments(const std::vector<int>& cells, size_t& out_first, size_t& out_last) const
+{
+	bool found = false;
+	for (size_t s = 0; s + 1 < cells.size(); s++)
+	{
+		// segments run straight or diagonally from one waypoint to the next
+		int x = cells[s] % dims.x, y = cells[s] / dims.x;
+		const int end_x = cells[s + 1] % dims.x, end_y = cells[s + 1] / dims.x;
+		const int dx = (end_x > x) - (end_x < x), dy = (end_y > y) - (end_y < y);
+		bool segment_blocked = blocked[y * dims.x + x] != 0;
+		while (!segment_blocked && (x != end_x || y != end_y))
+		{
+			// a diagonal step also needs the cells beside it
+			if (dx != 0 && dy != 0 && (!walkable(x + dx, y) || !walkable(x, y + dy)))
+				segment_blocked = true;
+			x += dx;
+			y += dy;
+			segment_blocked = segment_blocked || blocked[y * dims.x + x] != 0;
+		}
+		if (segment_blocked)
+		{
+			if (!found)
+				out_first = s;
+			out_last = s;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void Pathfinder::revalidate_cache(unsigned int old_version)
+{
+	for (auto entry = lru.begin(); entry != lru.end();)
+	{
+		cache.erase(entry->key);
+		if (entry->key.version != old_version)
+		{
+			stats.dropped_paths++;
+			entry = lru.erase(entry);
+			continue;
+		}
+		// Only newly blocked cells break a path, it may just not be the shortest anymore
+		size_t first, last;
+		if (!entry->stale && find_blocked_segments(entry->cells, first, last))
+			entry->stale = true;
+		if (entry->stale)
+			stats.stale_paths++;
+		else
+			stats.kept_paths++;
+		entry->key.version = version;
+		cache[entry->key] = entry;
+		++entry;
+	}
+}
+
+bool Pathfinder::repair_path(std::vector<int>& cells)
+{
+	size_t first = 0, last = 0;
+	if (!find_blocked_segments(cells, first, last))
+		return true;
+
+	// Replan from the last free waypoint before the blocked section to the first free one
+	// after it
+	size_t from = first, to = last + 1;
+	while (from > 0 && blocked[cells[from]])
+		from--;
+	while (to + 1 < cells.size() && blocked[cells[to]])
+		to++;
+	std::vector<int> detour;
+	if (blocked[cells[from]] || blocked[cells[to]] || !search(cells[from], cells[to], detour))
+		return false;
+	detour.insert(detour.end(), cells.begin() + to + 1, cells.end());
+	cells.erase(cells.begin() + from, cells.end());
+	cells.insert(cells.end(), detour.begin(), detour.end());
+	return true;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+
+// Counters of a Pathfinder since the last reset_stats()
+struct PathfinderStats
+{
+	unsigned int queries = 0;
+	unsigned int cache_hits = 0;
+	unsigned int jump_point_searches = 0; // on the fine grid, including the refinement of abstract paths
+	unsigned int abstract_searches = 0;
+	unsigned int obstacle_updates = 0; // end_obstacles() calls that changed cells
+	unsigned int dirty_clusters = 0;
+	unsigned int kept_paths = 0; // cached paths still valid after an update
+	unsigned int stale_paths = 0; // cached paths crossing newly blocked cells after an update
+	unsigned int repaired_paths = 0; // stale paths that were repaired when they were used
+	unsigned int dropped_paths = 0;
+};
+
+// Grid pathfinder for agents with goals of their own. Cells covered by obstacles are
+// blocked, diagonal moves need both cells beside them to be free.
+//
+// Short paths are found with Jump Point Search (A* that skips over the symmetric parts of
+// open ground). Long ones are planned on an abstraction first (HPA*): the grid is split
+// into square clusters, the free cells on either side of a cluster border become entrance
+// nodes and the nodes of a cluster are linked by their shortest distances within it. The
+// abstract path is then refined leg by leg with JPS. When obstacles move, only the
+// clusters around the changed cells are rebuilt.
+//
+// Paths are cached by start cell, goal cell and obstacle version with least recently used
+// eviction. When obstacles move, cached paths that don't cross a newly blocked cell are
+// carried over to the new version and the others get their blocked section replanned when
+// they are used next.
+class Pathfinder
+{
+public:
+	Pathfinder(vec2 area_size = { (float)window_width_px, (float)window_height_px }, float cell_size = 10.f, int cluster_size = 10);
+
+	// Obstacles are collected between begin_obstacles() and end_obstacles(), a cell is
+	// blocked if the circle touches it
+	void begin_obstacles();
+	void add_obstacle(vec2 center, float radius);
+	// Applies the collected obstacles, returns true if any cell changed
+	bool end_obstacles();
+
+	// Waypoints at cell centers from the start cell to the goal cell, consecutive ones are
+	// connected by straight or diagonal runs of free cells. Blocked start and goal cells are
+	// moved to a free cell nearby. Returns false if there is no path.
+	bool find_path(vec2 start, vec2 goal, std::vector<vec2>& out_waypoints);
+	// Jump Point Search on the fine grid only, bypassing the abstraction and the cache
+	bool find_path_direct(vec2 start, vec2 goal, std::vector<vec2>& out_waypoints);
+
+	bool is_blocked(vec2 position) const { return blocked[get_cell(position)] != 0; }
+	unsigned int get_version() const { return version; }
+	float get_cell_size() const { return cell_size; }
+	const PathfinderStats& get_stats() const { return stats; }
+	void reset_stats() { stats = PathfinderStats(); }
+
+	size_t cache_capacity = 256;
+
+private:
+	struct Cluster
+	{
+		ivec2 min; // first cell
+		ivec2 max; // one past the last cell
+		std::vector<int> entrances; // cells inside the cluster
+		std::vector<int> partners; // the cell on the other side of the border, per entrance
+		std::vector<float> distances; // entrances x entrances within the cluster, FLT_MAX if unconnected
+	};
+
+	struct CacheKey
+	{
+		int start;
+		int goal;
+		unsigned int version;
+		bool operator==(const CacheKey& other) const { return start == other.start && goal == other.goal && version == other.version; }
+	};
+	struct CacheKeyHash
+	{
+		size_t operator()(const CacheKey& key) const { return ((size_t)key.start * 73856093u) ^ ((size_t)key.goal * 19349663u) ^ key.version; }
+	};
+	struct CacheEntry
+	{
+		CacheKey key;
+		std::vector<int> cells; // waypoints
+		bool stale = false; // crosses a blocked cell
+	};
+
+	int get_cell(vec2 position) const;
+	bool walkable(int x, int y) const { return x >= 0 && y >= 0 && x < dims.x && y < dims.y && !blocked[y * dims.x + x]; }
+	// Free and within the bounds of the current search
+	bool passable(int x, int y) const
+	{
+		return x >= search_min.x && y >= search_min.y && x < search_max.x && y < search_max.y && !blocked[y * dims.x + x];
+	}
+	int cluster_of(int cell) const { return ((cell / dims.x) / cluster_size) * cluster_dims.x + (cell % dims.x) / cluster_size; }
+	float octile(int a, int b) const;
+	// The closest free cell within a few cells, -1 if there is none
+	int find_free_cell(int cell) const;
+
+	// Jump Point Search between two free cells within [bounds_min, bounds_max), appends the
+	// jump points after 'start'
+	bool jump_point_search(int start, int goal, std::vector<int>& out_cells, ivec2 bounds_min, ivec2 bounds_max);
+	int jump(int x, int y, int dx, int dy, int goal) const;
+	// Uses the abstraction for long paths, 'out_cells' starts with 'start'
+	bool search(int start, int goal, std::vector<int>& out_cells);
+	bool abstract_search(int start, int goal, std::vector<int>& out_cells);
+
+	// Rebuilds the entrances and distance tables of the cluster
+	void build_cluster(int cluster);
+	// Shortest distances within the cluster from 'from' to every cell of it
+	void cluster_dijkstra(int cluster, int from, std::vector<float>& out_distances);
+	void build_node_index();
+
+	// Carries the cached paths of the previous version over to the current one, marking
+	// the ones crossing blocked cells as stale
+	void revalidate_cache(unsigned int old_version);
+	// Replans the blocked section of the path, false if there is no way around it
+	bool repair_path(std::vector<int>& cells);
+	// Index of the first and last segment of the path crossing a blocked cell, false if none
+	bool find_blocked_segments(const std::vector<int>& cells, size_t& out_first, size_t& out_last) const;
+
+	float cell_size;
+	int cluster_size;
+	ivec2 dims;
+	ivec2 cluster_dims;
+	unsigned int version = 0;
+	PathfinderStats stats;
+
+	std::vector<uint8_t> blocked;
+	std::vector<uint8_t> next_blocked;
+	std::vector<Cluster> clusters;
+	std::vector<char> dirty;
+	// abstract graph nodes are numbered cluster by cluster
+	std::vector<int> cluster_first_node;
+	std::vector<int> node_of_cell; // -1 for cells that aren't entrances
+
+	// search state, a cell's g and parent are only valid if its stamp is the current search
+	std::vector<float> g;
+	std::vector<int> parent;
+	std::vector<unsigned int> seen;
+	std::vector<unsigned int> closed;
+	unsigned int search_stamp = 0;
+	ivec2 search_min;
+	ivec2 search_max;
+	std::vector<std::pair<float, int>> open; // min-heap of (f, cell or node)
+	std::vector<float> local_distances;
+	std::vector<float> start_links;
+	std::vector<float> goal_links;
+
+	std::list<CacheEntry> lru; // most recently used first
+	std::unordered_map<CacheKey, std::list<CacheEntry>::iterator, CacheKeyHash> cache;
+	std::vector<int> scratch_cells;
+};
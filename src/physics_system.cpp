@@ -1,6 +1,29 @@
 // internal
 #include "physics_system.hpp"
 #include "world_init.hpp"
+#include "fixed_point.hpp"
+#include "debug_draw.hpp"
+
+// stlib
+#include <chrono>
+
+// glm
+#include <glm/matrix.hpp> // inverse
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Scaled alpha masks that are kept before the cache starts over, stones come in random sizes.
+// It only starts over between steps, the narrowphase holds on to the masks of a pair.
+const size_t MAX_SCALED_MASKS = 256;
+
+// Microseconds since 'start', restarts the measurement
+static float lap_us(Clock::time_point& start)
+{
+	const Clock::time_point now = Clock::now();
+	const float us = (float)std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count() / 1000.f;
+	start = now;
+	return us;
+}
 
 // Returns the local bounding coordinates scaled by the current size of the entity
 vec2 get_bounding_box(const Motion& motion)
@@ -9,107 +32,688 @@ vec2 get_bounding_box(const Motion& motion)
 	return { abs(motion.scale.x), abs(motion.scale.y) };
 }
 
-// This is a SUPER APPROXIMATE check that puts a circle around the bounding boxes and sees
-// if the center point of either object is inside the other's bounding-box-circle. You can
-// surely implement a more accurate detection
-bool collides(const Motion& motion1, const Motion& motion2)
+// Layer interaction matrix: row i lists the layers that entities in layer (1 << i) react to.
+// It mirrors what WorldSystem::handle_collisions consumes, the first entity of a
+// Collision event is always the one reacting.
+const uint32_t layer_reacts_to[LAYER_COUNT] = {
+	LAYER_DEADLY | LAYER_EATABLE, // LAYER_PLAYER
+	LAYER_NONE,                   // LAYER_DEADLY
+	LAYER_NONE,                   // LAYER_EATABLE
+	LAYER_NONE,                   // LAYER_BLOWER
+	LAYER_BLOWER,                 // LAYER_BLOWABLE
+	LAYER_NONE                    // LAYER_DEBUG
+};
+
+uint32_t get_collision_layers(Entity entity)
+{
+	// debug graphics never collide, whatever else they carry
+	if (registry.debugComponents.has(entity))
+		return LAYER_DEBUG;
+	uint32_t layers = LAYER_NONE;
+	if (registry.players.has(entity))
+		layers |= LAYER_PLAYER;
+	if (registry.deadlys.has(entity))
+		layers |= LAYER_DEADLY;
+	if (registry.eatables.has(entity))
+		layers |= LAYER_EATABLE;
+	if (registry.blowers.has(entity))
+		layers |= LAYER_BLOWER;
+	if (registry.blowables.has(entity))
+		layers |= LAYER_BLOWABLE;
+	return layers;
+}
+
+uint32_t get_collision_mask(uint32_t layers)
+{
+	uint32_t mask = LAYER_NONE;
+	for (int i = 0; i < LAYER_COUNT; i++)
+		if (layers & (1u << i))
+			mask |= layer_reacts_to[i];
+	return mask;
+}
+
+// Wind carrying the entity, zero for anything that is not Blowable
+vec2 get_wind_velocity(Entity entity)
+{
+	if (registry.blowables.has(entity))
+		return registry.blowables.get(entity).wind_velocity;
+	return { 0.f, 0.f };
+}
+
+// Radius of the circle that is put around the bounding box
+float get_bounding_radius(const Motion& motion)
+{
+	const vec2 half_bounding_box = get_bounding_box(motion) / 2.f;
+	return sqrt(dot(half_bounding_box, half_bounding_box));
+}
+
+// First and cheapest tier of the narrowphase: puts a circle around the bounding boxes and
+// checks if the circles overlap. This is conservative, pairs failing it can't touch.
+bool collides_float(const Motion& motion1, const Motion& motion2)
 {
 	vec2 dp = motion1.position - motion2.position;
 	float dist_squared = dot(dp,dp);
-	const vec2 other_bonding_box = get_bounding_box(motion1) / 2.f;
-	const float other_r_squared = dot(other_bonding_box, other_bonding_box);
-	const vec2 my_bonding_box = get_bounding_box(motion2) / 2.f;
-	const float my_r_squared = dot(my_bonding_box, my_bonding_box);
-	const float r_squared = max(other_r_squared, my_r_squared);
-	if (dist_squared < r_squared)
+	const float r = get_bounding_radius(motion1) + get_bounding_radius(motion2);
+	if (dist_squared < r * r)
 		return true;
 	return false;
 }
 
-void PhysicsSystem::step(float elapsed_ms)
+// Same test as collides_float in Q24.8 fixed point, distances are squared in 64 bits
+bool collides_fixed(const Motion& motion1, const Motion& motion2)
+{
+	using namespace fixed_point;
+	const int64_t dx = from_float(motion1.position.x) - from_float(motion2.position.x);
+	const int64_t dy = from_float(motion1.position.y) - from_float(motion2.position.y);
+	const int64_t dist_squared = dx * dx + dy * dy;
+	// bounding radius = length of the half bounding box
+	const int64_t half_x1 = from_float(abs(motion1.scale.x) / 2.f), half_y1 = from_float(abs(motion1.scale.y) / 2.f);
+	const int64_t half_x2 = from_float(abs(motion2.scale.x) / 2.f), half_y2 = from_float(abs(motion2.scale.y) / 2.f);
+	const int64_t r = (int64_t)isqrt(half_x1 * half_x1 + half_y1 * half_y1) +
+		(int64_t)isqrt(half_x2 * half_x2 + half_y2 * half_y2);
+	return dist_squared < r * r;
+}
+
+bool collides(const Motion& motion1, const Motion& motion2)
+{
+#ifdef PHYSICS_FIXED_POINT
+	return collides_fixed(motion1, motion2);
+#else
+	return collides_float(motion1, motion2);
+#endif
+}
+
+// Same chain of transformations as in RenderSystem::drawTexturedMesh
+Transform get_transform(const Motion& motion)
+{
+	Transform transform;
+	transform.translate(motion.position);
+	transform.scale(motion.scale);
+	transform.rotate(motion.angle);
+	return transform;
+}
+
+// Corners of the unit square sprite geometry transformed into world space, i.e., the
+// bounding box oriented by motion.angle
+void get_oriented_box(const Motion& motion, vec2 out_corners[4])
+{
+	const mat3 mat = get_transform(motion).mat;
+	const vec2 local_corners[4] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+	for (int k = 0; k < 4; k++)
+		out_corners[k] = vec2(mat * vec3(local_corners[k], 1.f));
+}
+
+// Swept version of the bounding circle tier for fast movers: both objects travel linearly
+// from their start position to their current position during the step. Returns false if
+// they don't approach each other or their circles, with the same radius sum as
+// collides_float, don't overlap during the step. Otherwise 'out_time' in [0,1] is when the
+// centers come closest, the pose at which the finer tiers get to decide.
+bool find_swept_contact_time(const Motion& motion1, vec2 start1, const Motion& motion2, vec2 start2, float& out_time)
+{
+	const float r = get_bounding_radius(motion1) + get_bounding_radius(motion2);
+	// relative position d(t) = d0 + t * dd
+	const vec2 d0 = start1 - start2;
+	const vec2 dd = (motion1.position - start1) - (motion2.position - start2);
+	const float a = dot(dd, dd);
+	const float half_b = dot(d0, dd);
+	if (a < 1e-8f || half_b >= 0.f)
+		return false; // not approaching each other, the discrete tests saw them closest
+	// circles that don't overlap at the start have to reach dot(d(t), d(t)) = r^2 by t = 1
+	const float c = dot(d0, d0) - r * r;
+	if (c > 0.f)
+	{
+		const float discriminant = half_b * half_b - a * c;
+		if (discriminant < 0.f)
+			return false; // closest approach stays outside the radius
+		const float time_of_impact = (-half_b - sqrt(discriminant)) / a;
+		if (time_of_impact > 1.f)
+			return false;
+	}
+	out_time = min(-half_b / a, 1.f);
+	return true;
+}
+
+const MeshBVH* PhysicsSystem::get_mesh_bvh(Entity entity)
+{
+	if (!registry.meshPtrs.has(entity))
+		return nullptr;
+	const Mesh* mesh = registry.meshPtrs.get(entity);
+	auto it = mesh_bvhs.find(mesh);
+	if (it == mesh_bvhs.end())
+	{
+		// built once per mesh and shared by all entities referring to it
+		it = mesh_bvhs.emplace(mesh, MeshBVH()).first;
+		it->second.build(*mesh);
+	}
+	return it->second.empty() ? nullptr : &it->second;
+}
+
+bool PhysicsSystem::narrowphase(Entity entity1, const Motion& motion1, Entity entity2, const Motion& motion2)
+{
+	// Tier 1: bounding circles
+	if (!collides(motion1, motion2))
+		return false;
+
+	// Tier 2: bounding boxes oriented by motion.angle
+	vec2 box1[4], box2[4];
+	get_oriented_box(motion1, box1);
+	get_oriented_box(motion2, box2);
+	if (!convex_polygons_overlap(box1, 4, box2, 4))
+		return false;
+
+	// Tier 3: exact triangles if one side has a mesh (the chicken), tested against the
+	// box of the other side brought into the local coordinates of the mesh
+	const MeshBVH* bvh = get_mesh_bvh(entity1);
+	const Motion* mesh_motion = &motion1;
+	const vec2* other_box = box2;
+	if (bvh == nullptr)
+	{
+		bvh = get_mesh_bvh(entity2);
+		mesh_motion = &motion2;
+		other_box = box1;
+	}
+	if (bvh != nullptr)
+	{
+		const mat3 world_to_local = inverse(get_transform(*mesh_motion).mat);
+		vec2 local_box[4];
+		for (int k = 0; k < 4; k++)
+			local_box[k] = vec2(world_to_local * vec3(other_box[k], 1.f));
+		if (!bvh->intersects(local_box, 4))
+			return false;
+	}
+
+	// Tier 4: opaque pixels, the transparent corners of sprites don't collide
+	return pixels_overlap(entity1, motion1, entity2, motion2);
+}
+
+const BitMask* PhysicsSystem::get_sprite_pixels(Entity entity, const Motion& motion, ivec2& out_offset)
+{
+	// the rows of a mask only line up with the screen when the sprite isn't rotated
+	if (!registry.alphaMaskPtrs.has(entity) || motion.angle != 0.f)
+		return nullptr;
+	const AlphaMask* mask = registry.alphaMaskPtrs.get(entity);
+	if (mask->empty())
+		return nullptr;
+
+	const int width = max(1, (int)round(abs(motion.scale.x)));
+	const int height = max(1, (int)round(abs(motion.scale.y)));
+	out_offset = ivec2(round(motion.position - vec2(width, height) / 2.f));
+
+	// a negative scale mirrors the texture, the first texture row is at the top otherwise
+	const auto key = std::make_tuple(mask, width, height, motion.scale.x < 0.f, motion.scale.y < 0.f);
+	auto it = scaled_masks.find(key);
+	if (it == scaled_masks.end())
+	{
+		it = scaled_masks.emplace(key, BitMask()).first;
+		mask->resample(width, height, std::get<3>(key), std::get<4>(key), it->second);
+	}
+	return &it->second;
+}
+
+bool PhysicsSystem::pixels_overlap(Entity entity1, const Motion& motion1, Entity entity2, const Motion& motion2)
+{
+	ivec2 offset1, offset2;
+	const BitMask* pixels1 = get_sprite_pixels(entity1, motion1, offset1);
+	const BitMask* pixels2 = get_sprite_pixels(entity2, motion2, offset2);
+	if (pixels1 == nullptr && pixels2 == nullptr)
+		return true;
+	if (pixels1 != nullptr && pixels2 != nullptr)
+		return bit_masks_overlap(*pixels1, offset1, *pixels2, offset2);
+
+	// Rasterize the other side where it overlaps the sprite
+	const BitMask& sprite = pixels1 != nullptr ? *pixels1 : *pixels2;
+	const ivec2 sprite_offset = pixels1 != nullptr ? offset1 : offset2;
+	const Entity other = pixels1 != nullptr ? entity2 : entity1;
+	const Motion& other_motion = pixels1 != nullptr ? motion2 : motion1;
+
+	vec2 box[4];
+	get_oriented_box(other_motion, box);
+	vec2 box_min = box[0], box_max = box[0];
+	for (int k = 1; k < 4; k++)
+	{
+		box_min = min(box_min, box[k]);
+		box_max = max(box_max, box[k]);
+	}
+	const ivec2 region_min = max(sprite_offset, ivec2(floor(box_min)));
+	const ivec2 region_max = min(sprite_offset + ivec2(sprite.width, sprite.height), ivec2(ceil(box_max)));
+	if (region_min.x >= region_max.x || region_min.y >= region_max.y)
+		return false;
+	rasterized_pixels.resize(region_max.x - region_min.x, region_max.y - region_min.y);
+	const vec2 origin = vec2(region_min);
+
+	if (get_mesh_bvh(other) != nullptr)
+	{
+		const Mesh& mesh = *registry.meshPtrs.get(other);
+		const mat3 local_to_world = get_transform(other_motion).mat;
+		for (size_t i = 0; i + 2 < mesh.vertex_indices.size(); i += 3)
+		{
+			vec2 corners[3];
+			for (int k = 0; k < 3; k++)
+			{
+				const vec3& position = mesh.vertices[mesh.vertex_indices[i + k]].position;
+				corners[k] = vec2(local_to_world * vec3(position.x, position.y, 1.f)) - origin;
+			}
+			rasterized_pixels.fill_triangle(corners[0], corners[1], corners[2]);
+		}
+	}
+	else
+	{
+		rasterized_pixels.fill_triangle(box[0] - origin, box[1] - origin, box[2] - origin);
+		rasterized_pixels.fill_triangle(box[0] - origin, box[2] - origin, box[3] - origin);
+	}
+	return bit_masks_overlap(sprite, sprite_offset, rasterized_pixels, region_min);
+}
+
+void PhysicsSystem::emit_contact_event(ContactPair& pair, CONTACT_EVENT event)
+{
+	// removed entities don't receive events anymore
+	if (pair.first_reacts && registry.motions.has(pair.first))
+		registry.collisions.emplace_with_duplicates(pair.first, pair.second, event);
+	if (pair.second_reacts && registry.motions.has(pair.second))
+		registry.collisions.emplace_with_duplicates(pair.second, pair.first, event);
+}
+
+void PhysicsSystem::report_contact(Entity entity1, Entity entity2, bool entity1_reacts, bool entity2_reacts, bool stays)
+{
+	// key on the sorted pair of ids
+	if ((unsigned int)entity2 < (unsigned int)entity1)
+	{
+		std::swap(entity1, entity2);
+		std::swap(entity1_reacts, entity2_reacts);
+	}
+	const uint64_t key = ((uint64_t)(unsigned int)entity1 << 32) | (unsigned int)entity2;
+
+	auto it = contacts.find(key);
+	if (it == contacts.end())
+	{
+		// Emplaced whole, a default constructed pair would take new ids for its entities
+		ContactPair& pair = contacts.emplace(key, ContactPair{ entity1, entity2, entity1_reacts, entity2_reacts, stays, step_count }).first->second;
+		emit_contact_event(pair, CONTACT_EVENT::BEGIN);
+		return;
+	}
+
+	// Contacts are reported in every substep, each pair gets one event per step
+	if (it->second.last_touched_step == step_count)
+		return;
+	it->second.last_touched_step = step_count;
+	if (emit_stay_events || it->second.stays)
+		emit_contact_event(it->second, CONTACT_EVENT::STAY);
+}
+
+void PhysicsSystem::flush_ended_contacts()
+{
+	for (auto it = contacts.begin(); it != contacts.end();)
+	{
+		ContactPair& pair = it->second;
+		if (pair.last_touched_step != step_count)
+		{
+			const bool both_exist = registry.physicsBodies.has(pair.first) && registry.physicsBodies.has(pair.second);
+			// Pairs of sleeping bodies are not tested, they keep touching until one wakes up
+			if (both_exist && registry.physicsBodies.get(pair.first).asleep && registry.physicsBodies.get(pair.second).asleep)
+			{
+				pair.last_touched_step = step_count;
+				if (emit_stay_events || pair.stays)
+					emit_contact_event(pair, CONTACT_EVENT::STAY);
+			}
+			else
+			{
+				emit_contact_event(pair, CONTACT_EVENT::END);
+				it = contacts.erase(it);
+				continue;
+			}
+		}
+		++it;
+	}
+}
+
+void PhysicsSystem::store_previous_motions()
+{
+	auto& motion_registry = registry.motions;
+	for (uint i = 0; i < motion_registry.size(); i++)
+	{
+		const Motion& motion = motion_registry.components[i];
+		Entity entity = motion_registry.entities[i];
+		PreviousMotion& previous = registry.previousMotions.has(entity) ?
+			registry.previousMotions.get(entity) : registry.previousMotions.emplace(entity);
+		previous.position = motion.position;
+		previous.angle = motion.angle;
+		previous.scale = motion.scale;
+	}
+}
+
+void wake_up(PhysicsBody& body)
+{
+	body.asleep = false;
+	body.still_ticks = 0;
+}
+
+void PhysicsSystem::update_sleep_states()
+{
+	auto& motion_registry = registry.motions;
+	// Make sure every body has a sleep state before taking references, inserting may
+	// reallocate the container
+	for (uint i = 0; i < motion_registry.size(); i++)
+		if (!registry.physicsBodies.has(motion_registry.entities[i]))
+			registry.physicsBodies.emplace(motion_registry.entities[i]);
+
+	asleep.resize(motion_registry.size());
+	bodies.resize(motion_registry.size());
+	for (uint i = 0; i < motion_registry.size(); i++)
+	{
+		const Motion& motion = motion_registry.components[i];
+		PhysicsBody& body = registry.physicsBodies.get(motion_registry.entities[i]);
+		bodies[i] = &body;
+		const vec2 velocity = motion.velocity + get_wind_velocity(motion_registry.entities[i]);
+		if (dot(velocity, velocity) > SLEEP_VELOCITY * SLEEP_VELOCITY ||
+			(body.asleep && motion.position != body.rest_position))
+		{
+			// moving, this also wakes up sleeping bodies whose velocity or position was written
+			wake_up(body);
+		}
+		else if (!body.asleep && ++body.still_ticks >= SLEEP_TICKS)
+		{
+			body.asleep = true;
+			body.rest_position = motion.position;
+		}
+		asleep[i] = body.asleep;
+	}
+}
+
+// Containment of one axis for 'count' bodies against the range [0, size]. The loop body
+// has no calls and selects instead of branching so that the compiler can vectorize it.
+static void contain_axis(float* position, float* velocity, const float* extent, const uint8_t* policy,
+	uint8_t* left, float size, unsigned int count)
+{
+	const uint8_t clamp_policy = (uint8_t)BOUNDARY_POLICY::CLAMP;
+	const uint8_t reflect_policy = (uint8_t)BOUNDARY_POLICY::REFLECT;
+	const uint8_t despawn_policy = (uint8_t)BOUNDARY_POLICY::DESPAWN;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const float p = position[i];
+		const float v = velocity[i];
+		const float low = extent[i];
+		const float high = size - extent[i];
+		const bool outward = (p < low && v < 0.f) || (p > high && v > 0.f);
+		const bool inward = (p < low && v > 0.f) || (p > high && v < 0.f);
+		const bool gone = p + extent[i] < 0.f || p - extent[i] > size;
+
+		const bool contain = policy[i] == clamp_policy || policy[i] == reflect_policy;
+		position[i] = contain ? min(max(p, low), high) : p;
+		// clamping stops the motion into the border, reflecting reverses it
+		const float contained_velocity = policy[i] == clamp_policy ? 0.f : -v;
+		velocity[i] = (contain && outward) ? contained_velocity : v;
+		// entities spawned outside the window are only flagged if they don't move in
+		left[i] |= (uint8_t)(policy[i] == despawn_policy && gone && !inward);
+	}
+}
+
+void PhysicsSystem::apply_boundaries()
+{
+	// Gather
+	auto& motion_registry = registry.motions;
+	bounded.clear();
+	for (uint i = 0; i < motion_registry.size(); i++)
+		if (registry.boundaries.has(motion_registry.entities[i]))
+			bounded.push_back(i);
+	const unsigned int count = (unsigned int)bounded.size();
+	for (int axis = 0; axis < 2; axis++)
+	{
+		bound_position[axis].resize(count);
+		bound_velocity[axis].resize(count);
+		bound_extent[axis].resize(count);
+	}
+	bound_policy.resize(count);
+	bound_left.assign(count, 0);
+	for (unsigned int b = 0; b < count; b++)
+	{
+		const Motion& motion = motion_registry.components[bounded[b]];
+		const vec2 extent = get_bounding_box(motion) / 2.f;
+		for (int axis = 0; axis < 2; axis++)
+		{
+			bound_position[axis][b] = motion.position[axis];
+			bound_velocity[axis][b] = motion.velocity[axis];
+			bound_extent[axis][b] = extent[axis];
+		}
+		bound_policy[b] = (uint8_t)registry.boundaries.get(motion_registry.entities[bounded[b]]).policy;
+	}
+
+	contain_axis(bound_position[0].data(), bound_velocity[0].data(), bound_extent[0].data(), bound_policy.data(),
+		bound_left.data(), (float)window_width_px, count);
+	contain_axis(bound_position[1].data(), bound_velocity[1].data(), bound_extent[1].data(), bound_policy.data(),
+		bound_left.data(), (float)window_height_px, count);
+
+	// Scatter, only contained bodies change and flags are only added once
+	for (unsigned int b = 0; b < count; b++)
+	{
+		Entity entity = motion_registry.entities[bounded[b]];
+		if (bound_left[b])
+		{
+			if (!registry.outOfBounds.has(entity))
+			{
+				registry.outOfBounds.emplace(entity);
+				stats.out_of_bounds++;
+			}
+			continue;
+		}
+		Motion& motion = motion_registry.components[bounded[b]];
+		motion.position = { bound_position[0][b], bound_position[1][b] };
+		motion.velocity = { bound_velocity[0][b], bound_velocity[1][b] };
+	}
+}
+
+void PhysicsSystem::substep(float elapsed_ms)
 {
 	// Move bug based on how much time has passed, this is to (partially) avoid
 	// having entities move at different speed based on the machine.
+	Clock::time_point phase_start = Clock::now();
 	auto& motion_registry = registry.motions;
 	for(uint i = 0; i< motion_registry.size(); i++)
 	{
 		// !!! TODO A1: update motion.position based on step_seconds and motion.velocity
 		Motion& motion = motion_registry.components[i];
-		Entity entity = motion_registry.entities[i];
-		float step_seconds = elapsed_ms / 1000.f;
-		motion.position += step_seconds * motion.velocity;
-		//(void)elapsed_ms; // placeholder to silence unused warning until implemented
+		start_positions[i] = motion.position;
+		// sleeping bodies are not integrated, rigid bodies were moved by the solver
+		if (!asleep[i] && !is_rigid[i])
+		{
+			stats.bodies_integrated++;
+			const vec2 velocity = motion.velocity + wind[i];
+#ifdef PHYSICS_FIXED_POINT
+			motion.position = fixed_point::integrate(motion.position, velocity, elapsed_ms);
+#else
+			float step_seconds = elapsed_ms / 1000.f;
+			motion.position += step_seconds * velocity;
+#endif
+		}
+
+		// Bodies that travel further than their own radius in one step can tunnel
+		// through others, they get the swept test below
+		const vec2 displacement = motion.position - start_positions[i];
+		const float radius = radii[i];
+		is_fast[i] = dot(displacement, displacement) > radius * radius;
+
+		// the broadphase box covers the whole path of the substep
+		aabb_min[i] = min(start_positions[i], motion.position) - radius;
+		aabb_max[i] = max(start_positions[i], motion.position) + radius;
 	}
 
+	// Check for collisions between all moving entities, the grid only reports pairs with
+	// overlapping boxes of which at least one is awake
+	stats.integrate_us += lap_us(phase_start);
+	ComponentContainer<Motion> &motion_container = registry.motions;
+	broadphase.build(aabb_min.data(), aabb_max.data(), asleep.data(), (unsigned int)motion_container.size());
+	spatial_index.update(motion_container.entities.data(), motion_container.components.data(),
+		radii.data(), layers.data(), (unsigned int)motion_container.size());
+	stats.broadphase_us += lap_us(phase_start);
+	broadphase.for_each_pair([&](unsigned int i, unsigned int j) {
+		// Broadphase layer filter, skip pairs in which neither side reacts to the other
+		stats.broadphase_candidates++;
+		const bool i_reacts = (masks[i] & layers[j]) != 0;
+		const bool j_reacts = (masks[j] & layers[i]) != 0;
+		if (!i_reacts && !j_reacts)
+			return;
+		stats.narrowphase_tests++;
+
+		Motion& motion_i = motion_container.components[i];
+		Motion& motion_j = motion_container.components[j];
+		Entity entity_i = motion_container.entities[i];
+		Entity entity_j = motion_container.entities[j];
+		bool hit = narrowphase(entity_i, motion_i, entity_j, motion_j);
+		float contact_time;
+		if (!hit && (is_fast[i] || is_fast[j]) &&
+			find_swept_contact_time(motion_i, start_positions[i], motion_j, start_positions[j], contact_time))
+		{
+			// The pair may have passed through each other, all tiers test them where they were closest
+			Motion pose_i = motion_i;
+			Motion pose_j = motion_j;
+			pose_i.position = mix(start_positions[i], motion_i.position, contact_time);
+			pose_j.position = mix(start_positions[j], motion_j.position, contact_time);
+			hit = narrowphase(entity_i, pose_i, entity_j, pose_j);
+		}
+		if (hit)
+		{
+			stats.hits++;
+			// Contact wakes up sleeping bodies
+			wake_up(*bodies[i]);
+			wake_up(*bodies[j]);
+
+			// Create collision events for every side that reacts to the other if the contact is new
+			// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
+			report_contact(entity_i, entity_j, i_reacts, j_reacts, ((layers[i] | layers[j]) & stay_event_layers) != 0);
+		}
+	});
+	stats.narrowphase_us += lap_us(phase_start);
+}
+
+void PhysicsSystem::step(float elapsed_ms)
+{
+	step_count++;
+	stats = PhysicsStats();
+	stats.step = step_count;
+	Clock::time_point step_start = Clock::now();
+	Clock::time_point phase_start = step_start;
+	if (scaled_masks.size() >= MAX_SCALED_MASKS)
+		scaled_masks.clear();
+
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 	// TODO A3: HANDLE EGG UPDATES HERE
 	// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 3
+	// Eggs are RigidBody entities, the solver moves them and resolves their contacts
+	// (TODO A3: HANDLE EGG collisions) before the kinematic bodies are integrated
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+	rigid_body_solver.step(elapsed_ms);
+	stats.rigid_bodies_us = lap_us(phase_start);
+
+	update_sleep_states();
+	stats.sleep_us = lap_us(phase_start);
 
-	// Check for collisions between all moving entities
-    ComponentContainer<Motion> &motion_container = registry.motions;
-	for(uint i = 0; i<motion_container.components.size(); i++)
+	// Per-body data that stays the same over all substeps
+	auto& motion_registry = registry.motions;
+	start_positions.resize(motion_registry.size());
+	is_fast.resize(motion_registry.size());
+	layers.resize(motion_registry.size());
+	masks.resize(motion_registry.size());
+	aabb_min.resize(motion_registry.size());
+	aabb_max.resize(motion_registry.size());
+	radii.resize(motion_registry.size());
+	is_rigid.resize(motion_registry.size());
+	wind.resize(motion_registry.size());
+	float max_ratio_squared = 0.f;
+	for (uint i = 0; i < motion_registry.size(); i++)
 	{
-		Motion& motion_i = motion_container.components[i];
-		Entity entity_i = motion_container.entities[i];
-		
-		// note starting j at i+1 to compare all (i,j) pairs only once (and to not compare with itself)
-		for(uint j = i+1; j<motion_container.components.size(); j++)
+		const Motion& motion = motion_registry.components[i];
+		radii[i] = get_bounding_radius(motion);
+		layers[i] = get_collision_layers(motion_registry.entities[i]);
+		masks[i] = get_collision_mask(layers[i]);
+		is_rigid[i] = registry.rigidBodies.has(motion_registry.entities[i]);
+		wind[i] = get_wind_velocity(motion_registry.entities[i]);
+
+		// squared displacement over the whole step relative to the allowed displacement
+		if (!asleep[i] && !is_rigid[i] && radii[i] > 0.f)
 		{
-			Motion& motion_j = motion_container.components[j];
-			if (collides(motion_i, motion_j))
-			{
-				Entity entity_j = motion_container.entities[j];
-				// Create a collisions event
-				// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
-				registry.collisions.emplace_with_duplicates(entity_i, entity_j);
-				registry.collisions.emplace_with_duplicates(entity_j, entity_i);
-			}
+			const vec2 displacement = (motion.velocity + wind[i]) * (elapsed_ms / 1000.f);
+			const float allowed = SUBSTEP_DISPLACEMENT_FRACTION * radii[i];
+			max_ratio_squared = max(max_ratio_squared, dot(displacement, displacement) / (allowed * allowed));
 		}
 	}
 
+	// Fewest substeps that keep the fastest body under its allowed displacement, the
+	// swept test catches what is still too fast once the cap is reached
+	int substeps = (int)ceil(sqrt(max_ratio_squared));
+	substeps = max(1, min(substeps, MAX_SUBSTEPS));
+	stats.substeps = substeps;
+	stats.bodies = (unsigned int)motion_registry.size();
+	stats.integrate_us = lap_us(phase_start);
+
+	for (int substep_index = 0; substep_index < substeps; substep_index++)
+		substep(elapsed_ms / (float)substeps);
+	phase_start = Clock::now();
+
+	apply_boundaries();
+	stats.boundary_us = lap_us(phase_start);
+
+	flush_ended_contacts();
+	stats.active_contacts = (unsigned int)contacts.size();
+	stats.contacts_us = lap_us(phase_start);
+	stats.total_us = lap_us(step_start);
+
+	if (debugging.log_physics_stats)
+	{
+		const RigidBodyStats& rigid = rigid_body_solver.get_stats();
+		printf("physics %u: %d substeps, %u bodies, %u integrated, %u candidates, %u tests, %u hits, "
+			"%u contacts, %u out of bounds, %u rigid (%u awake, %u islands, %u contacts) | rigid %.0f "
+			"sleep %.0f integrate %.0f broad %.0f narrow %.0f bounds %.0f contacts %.0f total %.0f us\n",
+			stats.step, stats.substeps, stats.bodies, stats.bodies_integrated, stats.broadphase_candidates,
+			stats.narrowphase_tests, stats.hits, stats.active_contacts, stats.out_of_bounds, rigid.bodies,
+			rigid.awake_bodies, rigid.islands, rigid.contacts, stats.rigid_bodies_us, stats.sleep_us,
+			stats.integrate_us, stats.broadphase_us, stats.narrowphase_us, stats.boundary_us,
+			stats.contacts_us, stats.total_us);
+	}
+
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 	// TODO A2: HANDLE CHICKEN - WALL collisions HERE
 	// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 2
+	// Done in apply_boundaries() above, the chicken has a CLAMP Boundary
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
-	// you may need the following quantities to compute wall positions
-	(float)window_width_px; (float)window_height_px;
-
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 	// TODO A2: DRAW DEBUG INFO HERE on Chicken mesh collision
 	// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 2
-	// You will want to use the createLine from world_init.hpp
+	// Done below, mesh entities draw the triangles tested by the narrowphase
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
-	// debugging of bounding boxes
+	// debugging of bounding boxes, batched by debug_draw instead of one entity per line
 	if (debugging.in_debug_mode)
 	{
-		uint size_before_adding_new = (uint)motion_container.components.size();
-		for (uint i = 0; i < size_before_adding_new; i++)
+		for (uint i = 0; i < motion_registry.components.size(); i++)
 		{
-			Motion& motion_i = motion_container.components[i];
-			Entity entity_i = motion_container.entities[i];
+			const Motion& motion_i = motion_registry.components[i];
+			Entity entity_i = motion_registry.entities[i];
 
 			// don't draw debugging visuals around debug lines
 			if (registry.debugComponents.has(entity_i))
 				continue;
 
-			// visualize the radius with two axis-aligned lines
-			const vec2 bonding_box = get_bounding_box(motion_i);
-			float radius = sqrt(dot(bonding_box/2.f, bonding_box/2.f));
-			vec2 line_scale1 = { motion_i.scale.x / 10, 2*radius };
-			vec2 line_scale2 = { 2*radius, motion_i.scale.x / 10};
-			vec2 position = motion_i.position;
-			Entity line1 = createLine(motion_i.position, line_scale1);
-			Entity line2 = createLine(motion_i.position, line_scale2);
+			// bounding circle of the broadphase and oriented box of the narrowphase
+			debug_draw_circle(motion_i.position, get_bounding_radius(motion_i));
+			vec2 corners[4];
+			get_oriented_box(motion_i, corners);
+			debug_draw_polygon(corners, 4, { 0.1f, 0.8f, 0.1f });
 
-			// !!! TODO A2: implement debug bounding boxes instead of crosses
+			if (registry.meshPtrs.has(entity_i))
+			{
+				const Mesh* mesh = registry.meshPtrs.get(entity_i);
+				const mat3 transform = get_transform(motion_i).mat;
+				for (size_t t = 0; t + 2 < mesh->vertex_indices.size(); t += 3)
+				{
+					vec2 triangle[3];
+					for (int v = 0; v < 3; v++)
+					{
+						const vec3 local = mesh->vertices[mesh->vertex_indices[t + v]].position;
+						triangle[v] = vec2(transform * vec3(local.x, local.y, 1.f));
+					}
+					debug_draw_polygon(triangle, 3, { 0.1f, 0.1f, 0.8f });
+				}
+			}
 		}
 	}
-
-	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-	// TODO A3: HANDLE EGG collisions HERE
-	// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 3
-	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 }
\ No newline at end of file
@@ -4,6 +4,73 @@
 #include "tiny_ecs.hpp"
 #include "components.hpp"
 #include "tiny_ecs_registry.hpp"
+#include "mesh_bvh.hpp"
+#include "alpha_mask.hpp"
+#include "broadphase_grid.hpp"
+#include "spatial_index.hpp"
+#include "rigid_body_solver.hpp"
+
+#include <map>
+#include <unordered_map>
+
+// Collision layers an entity belongs to, derived from its components.
+enum COLLISION_LAYER {
+	LAYER_NONE = 0,
+	LAYER_PLAYER = 1 << 0,
+	LAYER_DEADLY = 1 << 1,
+	LAYER_EATABLE = 1 << 2,
+	LAYER_BLOWER = 1 << 3,
+	LAYER_BLOWABLE = 1 << 4,
+	LAYER_DEBUG = 1 << 5,
+	LAYER_COUNT = 6
+};
+
+// Returns the COLLISION_LAYER bits of an entity based on the components it has
+uint32_t get_collision_layers(Entity entity);
+
+// Returns the layers an entity with the given layers reacts to, a pair of entities is
+// only tested if at least one of them reacts to the other
+uint32_t get_collision_mask(uint32_t layers);
+
+// Bounding circle test used as first narrowphase tier. collides() dispatches to the fixed
+// point version when built with PHYSICS_FIXED_POINT, both are exposed for benchmarking.
+bool collides(const Motion& motion1, const Motion& motion2);
+bool collides_float(const Motion& motion1, const Motion& motion2);
+bool collides_fixed(const Motion& motion1, const Motion& motion2);
+
+// Bodies slower than SLEEP_VELOCITY (in pixels per second) for SLEEP_TICKS consecutive
+// steps fall asleep until their velocity is written or something touches them
+const float SLEEP_VELOCITY = 1.f;
+const int SLEEP_TICKS = 30;
+
+// A step is split into substeps so that no awake body moves further than this fraction
+// of its bounding radius per substep, up to MAX_SUBSTEPS
+const float SUBSTEP_DISPLACEMENT_FRACTION = 0.5f;
+const int MAX_SUBSTEPS = 8;
+
+// Counters and timings of the last PhysicsSystem::step, times are in microseconds
+struct PhysicsStats
+{
+	unsigned int step = 0;
+	int substeps = 0;
+	unsigned int bodies = 0;
+	// the following counters and times are summed over all substeps
+	unsigned int bodies_integrated = 0; // awake bodies
+	unsigned int broadphase_candidates = 0; // pairs with overlapping boxes
+	unsigned int narrowphase_tests = 0; // candidates left after the layer filter
+	unsigned int hits = 0;
+	unsigned int active_contacts = 0;
+	unsigned int out_of_bounds = 0; // entities newly flagged with OutOfBounds
+
+	float rigid_bodies_us = 0.f; // RigidBodySolver step
+	float sleep_us = 0.f;
+	float integrate_us = 0.f;
+	float broadphase_us = 0.f; // grid and spatial index rebuild
+	float narrowphase_us = 0.f; // pair enumeration, layer filter and all narrowphase tiers
+	float boundary_us = 0.f; // window containment pass
+	float contacts_us = 0.f; // contact cache flush and END events
+	float total_us = 0.f;
+};
 
 // A simple physics system that moves rigid bodies and checks for collision
 class PhysicsSystem
@@ -11,7 +78,112 @@ class PhysicsSystem
 public:
 	void step(float elapsed_ms);
 
+	// Remember the motion state at the start of a tick for render interpolation
+	void store_previous_motions();
+
 	PhysicsSystem()
+		: spatial_index(broadphase)
 	{
 	}
+
+	// Radius, box, ray and nearest neighbor queries over the bodies of the last step
+	const SpatialIndex& get_spatial_index() const { return spatial_index; }
+
+	// Simulates the RigidBody entities (eggs) at the start of every step
+	RigidBodySolver& get_rigid_body_solver() { return rigid_body_solver; }
+
+	// Counters of the last step, also printed every step while debugging.log_physics_stats is set
+	const PhysicsStats& get_stats() const { return stats; }
+
+	// Also emit a STAY event for every ongoing contact each step, off by default since
+	// gameplay only reacts to contacts starting
+	bool emit_stay_events = false;
+	// Contacts with a body on these COLLISION_LAYER bits emit STAY events either way
+	uint32_t stay_event_layers = LAYER_NONE;
+
+private:
+	// Integrates all awake bodies by elapsed_ms and reports the contacts at the new positions
+	void substep(float elapsed_ms);
+
+	// Keeps entities with a Boundary component inside the window according to their policy
+	// and flags the ones that left it, see BOUNDARY_POLICY
+	void apply_boundaries();
+
+	// Updates the PhysicsBody sleep state of every motion and fills 'asleep' and 'bodies'
+	void update_sleep_states();
+
+	// Tiered narrowphase: bounding circles, then oriented boxes, then the exact mesh
+	// triangles for entities with a mesh, then the opaque pixels for entities with an
+	// AlphaMask. Every tier only runs if the cheaper one passed.
+	bool narrowphase(Entity entity1, const Motion& motion1, Entity entity2, const Motion& motion2);
+
+	// Last narrowphase tier: ANDs the opaque pixels of the sprite(s) in the pair, the side
+	// without an alpha mask is rasterized from its mesh triangles or its oriented box.
+	// Pairs without any alpha mask pass.
+	bool pixels_overlap(Entity entity1, const Motion& motion1, Entity entity2, const Motion& motion2);
+
+	// A pair of touching entities, first has the lower id. Pairs are kept across steps
+	// so that only changes in contact are reported.
+	struct ContactPair
+	{
+		Entity first;
+		Entity second;
+		bool first_reacts;
+		bool second_reacts;
+		bool stays; // emits STAY events whatever emit_stay_events says
+		unsigned int last_touched_step;
+	};
+
+	// Records that two entities touch in this step and emits BEGIN (or STAY) events, only
+	// for the first substep they touch in
+	void report_contact(Entity entity1, Entity entity2, bool entity1_reacts, bool entity2_reacts, bool stays);
+
+	// Emits END events for all cached pairs that were not touched in this step and drops them
+	void flush_ended_contacts();
+
+	// Emits a Collision event to every side of the pair that reacts to the other
+	void emit_contact_event(ContactPair& pair, CONTACT_EVENT event);
+
+	std::unordered_map<uint64_t, ContactPair> contacts;
+	unsigned int step_count = 0;
+	PhysicsStats stats;
+
+	// Returns the triangle hierarchy of the entity's mesh, nullptr for meshes without triangles
+	const MeshBVH* get_mesh_bvh(Entity entity);
+	std::unordered_map<const Mesh*, MeshBVH> mesh_bvhs;
+
+	// Returns the alpha mask of the entity scaled to its size in pixels and the position of its
+	// top left pixel, nullptr without an alpha mask or when rotated
+	const BitMask* get_sprite_pixels(Entity entity, const Motion& motion, ivec2& out_offset);
+	// Scaled masks by alpha mask, width, height, flip x and flip y. Only cleared at the start of
+	// a step, the returned masks stay valid until then.
+	std::map<std::tuple<const AlphaMask*, int, int, bool, bool>, BitMask> scaled_masks;
+	BitMask rasterized_pixels; // scratch for pixels_overlap
+
+	// Per-step scratch buffers indexed like registry.motions, kept around to avoid
+	// reallocating every step
+	std::vector<vec2> start_positions;
+	std::vector<bool> is_fast;
+	std::vector<uint32_t> layers;
+	std::vector<uint32_t> masks;
+	std::vector<vec2> aabb_min;
+	std::vector<vec2> aabb_max;
+	std::vector<float> radii;
+	std::vector<char> asleep;
+	std::vector<char> is_rigid; // moved by the rigid body solver, not integrated here
+	std::vector<vec2> wind; // Blowable::wind_velocity, added to the velocity when integrating
+	std::vector<PhysicsBody*> bodies;
+
+	// Structure of arrays copy of the bodies with a Boundary component, one array per axis
+	// so that the containment pass is a plain loop over floats
+	std::vector<unsigned int> bounded;
+	std::vector<float> bound_position[2];
+	std::vector<float> bound_velocity[2];
+	std::vector<float> bound_extent[2];
+	std::vector<uint8_t> bound_policy;
+	std::vector<uint8_t> bound_left;
+
+	BroadphaseGrid broadphase;
+	SpatialIndex spatial_index;
+	RigidBodySolver rigid_body_solver;
 };
\ No newline at end of file
@@ -0,0 +1,136 @@
+// internal
+#include "planner.hpp"
+
+// stlib
+#include <chrono>
+
+using Clock = std::chrono::high_resolution_clock;
+
+void PlanningSnapshot::clear()
+{
+	has_chicken = false;
+	bugs.clear();
+	members.clear();
+	member_positions.clear();
+	obstacles.clear();
+	path_requests.clear();
+}
+
+bool PlanningResult::get_slot(Entity member, vec2& out_position) const
+{
+	auto found = member_slot.find(member);
+	if (found == member_slot.end() || found->second >= slots.size())
+		return false;
+	out_position = slots[found->second];
+	return true;
+}
+
+Planner::Planner()
+{
+	// Off the frame there is no reason to spread an assignment over several plans
+	formation.rows_per_step = formation.max_slots;
+}
+
+Planner::~Planner()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	work_ready.notify_all();
+	if (worker.joinable())
+		worker.join();
+}
+
+bool Planner::can_publish(bool threaded)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (threaded)
+		return pending_index < 0;
+	return pending_index < 0 && reading_index < 0 && !has_finished;
+}
+
+void Planner::publish(bool threaded)
+{
+	if (!threaded)
+	{
+		plan(snapshots[write_index], working);
+		std::lock_guard<std::mutex> lock(mutex);
+		std::swap(working, finished);
+		has_finished = true;
+		return;
+	}
+
+	if (!worker.joinable())
+		worker = std::thread(&Planner::worker_loop, this);
+	{
+		// The worker reads at most the other buffer, which is free again once it is done
+		std::lock_guard<std::mutex> lock(mutex);
+		pending_index = write_index;
+		write_index = 1 - write_index;
+	}
+	work_ready.notify_one();
+}
+
+bool Planner::take_result(PlanningResult& out_result)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!has_finished)
+			return false;
+		std::swap(finished, out_result);
+		has_finished = false;
+	}
+	work_ready.notify_one();
+	return true;
+}
+
+void Planner::worker_loop()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			work_ready.wait(lock, [this] { return stopping || (pending_index >= 0 && !has_finished); });
+			if (stopping)
+				return;
+			reading_index = pending_index;
+			pending_index = -1;
+		}
+		plan(snapshots[reading_index], working);
+		std::lock_guard<std::mutex> lock(mutex);
+		std::swap(working, finished);
+		has_finished = true;
+		reading_index = -1;
+	}
+}
+
+void Planner::plan(const PlanningSnapshot& snapshot, PlanningResult& out_result)
+{
+	const Clock::time_point start = Clock::now();
+	out_result.step = snapshot.step;
+	out_result.valid = true;
+
+	pathfinder.begin_obstacles();
+	for (vec3 obstacle : snapshot.obstacles)
+		pathfinder.add_obstacle({ obstacle.x, obstacle.y }, obstacle.z);
+	pathfinder.end_obstacles();
+	out_result.paths.clear();
+	for (const PathRequest& request : snapshot.path_requests)
+	{
+		// Agents on the same cells share the cached path
+		out_result.paths.push_back({ request.entity, request.destination, {} });
+		pathfinder.find_path(request.start, request.destination, out_result.paths.back().waypoints);
+	}
+	out_result.pathfinder_version = pathfinder.get_version();
+
+	if (snapshot.has_chicken)
+		formation.update(snapshot.chicken, snapshot.bugs, snapshot.members, snapshot.member_positions);
+	else
+		formation.clear();
+	out_result.front = formation.get_front();
+	out_result.slots = formation.get_slots();
+	out_result.member_slot = formation.get_member_slots();
+
+	out_result.plan_us = (float)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count() / 1000.f;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+#include "tiny_ecs.hpp"
+#include "formation.hpp"
+#include "pathfinder.hpp"
+
+// Path wanted by an agent. Entities cross the threads only as copies, the worker must not
+// create any.
+struct PathRequest
+{
+	Entity entity;
+	vec2 start;
+	vec2 destination;
+};
+
+struct PlannedPath
+{
+	Entity entity;
+	vec2 destination;
+	std::vector<vec2> waypoints; // empty if there is no path
+};
+
+// Copy of what the planning needs of the world, taken by the AISystem at the end of a step
+struct PlanningSnapshot
+{
+	unsigned int step = 0; // AISystem step it was taken in
+	bool has_chicken = false;
+	vec2 chicken = { 0, 0 };
+	std::vector<vec2> bugs;
+	std::vector<Entity> members; // eagles holding the frontier
+	std::vector<vec2> member_positions;
+	std::vector<vec3> obstacles; // center and radius
+	std::vector<PathRequest> path_requests;
+
+	void clear();
+};
+
+// Everything planned from one snapshot
+struct PlanningResult
+{
+	unsigned int step = 0; // of the snapshot
+	bool valid = false; // false until the first plan
+	// the formation, slot of every member by entity id
+	std::vector<vec2> front;
+	std::vector<vec2> slots;
+	std::unordered_map<unsigned int, unsigned int> member_slot;
+	// paths for the requests of the snapshot, planned with this version of the obstacles
+	std::vector<PlannedPath> paths;
+	unsigned int pathfinder_version = 0;
+	float plan_us = 0.f;
+
+	// Position of the slot of a member, false without one
+	bool get_slot(Entity member, vec2& out_position) const;
+};
+
+// Plans the paths and the frontier formation of the AISystem on a thread of its own, so
+// that a frame only pays for copying the snapshot and applying the results.
+//
+// The snapshots are double buffered: the AISystem fills the buffer the worker isn't
+// reading and hands it over with publish(), the worker only ever reads a snapshot. While
+// the previous snapshot is still waiting for the worker no new one can be published, the
+// AISystem then keeps its requests for the next one. The worker hands every result back
+// and only starts on the next snapshot once it was taken, so no requests get lost. The
+// worker owns the Pathfinder and the Formation, nothing else touches them.
+//
+// Without 'threaded' the snapshot is planned on the calling thread in publish(), once the
+// worker is idle.
+class Planner
+{
+public:
+	Planner();
+	~Planner();
+
+	Planner(const Planner&) = delete;
+	Planner& operator=(const Planner&) = delete;
+
+	// The buffer to fill for the next publish()
+	PlanningSnapshot& get_snapshot() { return snapshots[write_index]; }
+	// True if a snapshot can be filled and published now
+	bool can_publish(bool threaded);
+	// Hands the filled snapshot over, only after can_publish()
+	void publish(bool threaded);
+	// Replaces 'out_result' with the next result, false if there is none since the last call
+	bool take_result(PlanningResult& out_result);
+
+	// Fixed at construction, safe to read while the worker runs
+	float get_path_cell_size() const { return pathfinder.get_cell_size(); }
+
+private:
+	void worker_loop();
+	void plan(const PlanningSnapshot& snapshot, PlanningResult& out_result);
+
+	Pathfinder pathfinder;
+	Formation formation;
+
+	PlanningSnapshot snapshots[2];
+	int write_index = 0; // buffer of the main thread
+	int pending_index = -1; // published and waiting for the worker, -1 for none
+	int reading_index = -1; // planned by the worker, -1 while it is idle
+	PlanningResult working; // of the worker
+	PlanningResult finished; // handed back and not taken yet
+	bool has_finished = false;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable work_ready; // a snapshot is pending and the last result was taken
+	bool stopping = false;
+};
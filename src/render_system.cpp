@@ -3,11 +3,31 @@
 #include <SDL.h>
 
 #include "tiny_ecs_registry.hpp"
+#include "debug_draw.hpp"
+
+// Blends the motion state of the previous tick into the current one, entities
+// created during the last tick have no previous state and are drawn as they are
+static Motion interpolate_motion(Entity entity, float alpha)
+{
+	Motion motion = registry.motions.get(entity);
+	if (!registry.previousMotions.has(entity))
+		return motion;
+
+	const PreviousMotion &previous = registry.previousMotions.get(entity);
+	motion.position = mix(previous.position, motion.position, alpha);
+	motion.scale = mix(previous.scale, motion.scale, alpha);
+	// take the shorter way around the circle, atan2 wraps at +-pi
+	const float two_pi = 2.f * (float)M_PI;
+	float delta_angle = motion.angle - previous.angle;
+	delta_angle -= two_pi * floorf((delta_angle + 0.5f * two_pi) / two_pi);
+	motion.angle = previous.angle + alpha * delta_angle;
+	return motion;
+}
 
 void RenderSystem::drawTexturedMesh(Entity entity,
-									const mat3 &projection)
+									const mat3 &projection, float alpha)
 {
-	Motion &motion = registry.motions.get(entity);
+	const Motion motion = interpolate_motion(entity, alpha);
 	// Transformation code, see Rendering and Transformation in the template
 	// specification for more info Incrementally updates transformation matrix,
 	// thus ORDER IS IMPORTANT
@@ -188,9 +208,43 @@ void RenderSystem::drawToScreen()
 	gl_has_errors();
 }
 
+void RenderSystem::drawDebugLines(const mat3 &projection)
+{
+	const std::vector<ColoredVertex> &vertices = debug_draw_vertices();
+	if (vertices.empty())
+		return;
+
+	// The egg effect passes the vertex colors through, the vertices are in world coordinates
+	const GLuint program = effects[(GLuint)EFFECT_ASSET_ID::EGG];
+	glUseProgram(program);
+	gl_has_errors();
+
+	glBindBuffer(GL_ARRAY_BUFFER, debug_vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(ColoredVertex) * vertices.size(), vertices.data(), GL_STREAM_DRAW);
+	gl_has_errors();
+
+	GLint in_position_loc = glGetAttribLocation(program, "in_position");
+	GLint in_color_loc = glGetAttribLocation(program, "in_color");
+	glEnableVertexAttribArray(in_position_loc);
+	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void *)0);
+	glEnableVertexAttribArray(in_color_loc);
+	glVertexAttribPointer(in_color_loc, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void *)sizeof(vec3));
+	gl_has_errors();
+
+	const vec3 color = vec3(1);
+	glUniform3fv(glGetUniformLocation(program, "fcolor"), 1, (float *)&color);
+	const Transform identity;
+	glUniformMatrix3fv(glGetUniformLocation(program, "transform"), 1, GL_FALSE, (float *)&identity.mat);
+	glUniformMatrix3fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, (float *)&projection);
+	gl_has_errors();
+
+	glDrawArrays(GL_LINES, 0, (GLsizei)vertices.size());
+	gl_has_errors();
+}
+
 // Render our game world
 // http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-14-render-to-texture/
-void RenderSystem::draw()
+void RenderSystem::draw(float alpha)
 {
 	// Getting size of window
 	int w, h;
@@ -219,8 +273,9 @@ void RenderSystem::draw()
 			continue;
 		// Note, its not very efficient to access elements indirectly via the entity
 		// albeit iterating through all Sprites in sequence. A good point to optimize
-		drawTexturedMesh(entity, projection_2D);
+		drawTexturedMesh(entity, projection_2D, alpha);
 	}
+	drawDebugLines(projection_2D);
 
 	// Truely render to the screen
 	drawToScreen();
@@ -5,6 +5,7 @@
 
 #include "common.hpp"
 #include "components.hpp"
+#include "alpha_mask.hpp"
 #include "tiny_ecs.hpp"
 
 // System responsible for setting up OpenGL and for rendering all the
@@ -19,6 +20,8 @@ class RenderSystem {
 	 */
 	std::array<GLuint, texture_count> texture_gl_handles;
 	std::array<ivec2, texture_count> texture_dimensions;
+	// Opaque texels of every texture for the pixel accurate collision test
+	std::array<AlphaMask, texture_count> alpha_masks;
 
 	// Make sure these paths remain in sync with the associated enumerators.
 	// Associated id with .obj path
@@ -62,6 +65,8 @@ public:
 	void initializeGlMeshes();
 	Mesh& getMesh(GEOMETRY_BUFFER_ID id) { return meshes[(int)id]; };
 
+	AlphaMask& getAlphaMask(TEXTURE_ASSET_ID id) { return alpha_masks[(int)id]; };
+
 	void initializeGlGeometryBuffers();
 	// Initialize the screen texture used as intermediate render target
 	// The draw loop first renders to this texture, then it is used for the wind
@@ -71,15 +76,18 @@ public:
 	// Destroy resources associated to one or all entities created by the system
 	~RenderSystem();
 
-	// Draw all entities
-	void draw();
+	// Draw all entities, alpha is the fraction of a simulation tick elapsed since
+	// the last step and blends each entity from its previous to its current motion
+	void draw(float alpha = 1.f);
 
 	mat3 createProjectionMatrix();
 
 private:
 	// Internal drawing functions for each entity type
-	void drawTexturedMesh(Entity entity, const mat3& projection);
+	void drawTexturedMesh(Entity entity, const mat3& projection, float alpha);
 	void drawToScreen();
+	// Draws all shapes accumulated by debug_draw.hpp with a single draw call
+	void drawDebugLines(const mat3& projection);
 
 	// Window handle
 	GLFWwindow* window;
@@ -89,6 +97,9 @@ private:
 	GLuint off_screen_render_buffer_color;
 	GLuint off_screen_render_buffer_depth;
 
+	// Streamed every frame with the debug draw line list
+	GLuint debug_vertex_buffer;
+
 	Entity screen_state_entity;
 };
 
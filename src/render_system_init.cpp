@@ -86,6 +86,7 @@ void RenderSystem::initializeGlTextures()
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		gl_has_errors();
+		alpha_masks[i].build(data, dimensions.x, dimensions.y);
 		stbi_image_free(data);
     }
 	gl_has_errors();
@@ -146,6 +147,9 @@ void RenderSystem::initializeGlGeometryBuffers()
 	// Index and Vertex buffer data initialization.
 	initializeGlMeshes();
 
+	// Debug draw vertices are uploaded every frame, no index buffer needed
+	glGenBuffers(1, &debug_vertex_buffer);
+
 	//////////////////////////
 	// Initialize sprite
 	// The position corresponds to the center of the texture.
@@ -231,6 +235,7 @@ RenderSystem::~RenderSystem()
 	// but it's polite to clean after yourself.
 	glDeleteBuffers((GLsizei)vertex_buffers.size(), vertex_buffers.data());
 	glDeleteBuffers((GLsizei)index_buffers.size(), index_buffers.data());
+	glDeleteBuffers(1, &debug_vertex_buffer);
 	glDeleteTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
 	glDeleteTextures(1, &off_screen_render_buffer_color);
 	glDeleteRenderbuffers(1, &off_screen_render_buffer_depth);
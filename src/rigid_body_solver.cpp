@@ -0,0 +1,418 @@
+// internal
+#include "rigid_body_solver.hpp"
+#include "tiny_ecs_registry.hpp"
+
+// stlib
+#include <algorithm>
+
+// Contacts can penetrate this far without correction, which keeps resting contacts touching
+const float PENETRATION_SLOP = 0.5f;
+// Fraction of the remaining penetration removed per step
+const float BAUMGARTE = 0.2f;
+// Slower impacts don't bounce, resting bodies would jitter otherwise
+const float RESTITUTION_VELOCITY = 50.f;
+// A body is still below these velocities, an island whose bodies have all been still
+// for SLEEP_SECONDS falls asleep
+const float SLEEP_LINEAR_VELOCITY = 5.f;
+const float SLEEP_ANGULAR_VELOCITY = 0.1f;
+const float SLEEP_SECONDS = 0.5f;
+
+// Velocity damping per second. Eggs aren't round, the strong angular damping stands in
+// for the rolling resistance that keeps them from rolling away forever.
+const float LINEAR_DAMPING = 0.1f;
+const float ANGULAR_DAMPING = 3.f;
+
+// Planes are keyed like a pair with one of these pseudo ids
+const unsigned int FLOOR_ID = ~0u;
+const unsigned int LEFT_WALL_ID = ~0u - 1;
+const unsigned int RIGHT_WALL_ID = ~0u - 2;
+
+static uint64_t contact_key(unsigned int id1, unsigned int id2)
+{
+	return ((uint64_t)id1 << 32) | id2;
+}
+
+// 2D cross products
+static float cross(vec2 a, vec2 b) { return a.x * b.y - a.y * b.x; }
+static vec2 cross(float w, vec2 r) { return { -w * r.y, w * r.x }; }
+
+const unsigned int RigidBodySolver::NO_BODY;
+
+RigidBodySolver::RigidBodySolver(JobSystem& jobs_arg)
+	: jobs(jobs_arg)
+{
+	set_bounds({ 0.f, -256.f }, { (float)window_width_px, (float)window_height_px });
+}
+
+void RigidBodySolver::set_bounds(vec2 area_min, vec2 area_max, float cell_size)
+{
+	left_wall = area_min.x;
+	right_wall = area_max.x;
+	floor = area_max.y;
+	grid = BroadphaseGrid(area_min, area_max, cell_size);
+	impulse_cache.clear();
+}
+
+void RigidBodySolver::wake(unsigned int body)
+{
+	if (inverse_mass[body] == 0.f || !asleep[body])
+		return;
+	asleep[body] = false;
+	still_time[body] = 0.f;
+}
+
+unsigned int RigidBodySolver::find_root(unsigned int body)
+{
+	while (parent[body] != body)
+	{
+		parent[body] = parent[parent[body]]; // path halving
+		body = parent[body];
+	}
+	return body;
+}
+
+void RigidBodySolver::find_contacts()
+{
+	const unsigned int count = (unsigned int)position.size();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		aabb_min[i] = position[i] - radius[i];
+		aabb_max[i] = position[i] + radius[i];
+	}
+	grid.build(aabb_min.data(), aabb_max.data(), asleep.data(), count);
+
+	const ComponentContainer<RigidBody>& rigid_bodies = registry.rigidBodies;
+	contacts.clear();
+	grid.for_each_pair([&](unsigned int a, unsigned int b) {
+		const vec2 d = position[b] - position[a];
+		const float r = radius[a] + radius[b];
+		const float distance_squared = dot(d, d);
+		if (distance_squared >= r * r)
+			return;
+		// Order by id so that the tangent of a cached impulse keeps its direction
+		if (ids[a] > ids[b])
+			std::swap(a, b);
+
+		// Something awake touches a sleeping body
+		wake(a);
+		wake(b);
+
+		const float distance = sqrt(distance_squared);
+		Contact contact;
+		contact.a = a;
+		contact.b = b;
+		contact.normal = distance > 1e-6f ? (position[b] - position[a]) / distance : vec2(0.f, 1.f);
+		contact.penetration = r - distance;
+		const RigidBody& body_a = rigid_bodies.components[a];
+		const RigidBody& body_b = rigid_bodies.components[b];
+		contact.friction = sqrt(body_a.friction * body_b.friction);
+		contact.restitution = max(body_a.restitution, body_b.restitution);
+		contact.key = contact_key(ids[a], ids[b]);
+		contacts.push_back(contact);
+	});
+
+	// Floor and walls, only for awake bodies as nothing else moves sleeping ones
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (asleep[i])
+			continue;
+		const RigidBody& body = rigid_bodies.components[i];
+		struct Plane { vec2 normal; float penetration; unsigned int id; };
+		const Plane planes[3] = {
+			{ { 0.f, 1.f }, position[i].y + radius[i] - floor, FLOOR_ID },
+			{ { -1.f, 0.f }, left_wall - (position[i].x - radius[i]), LEFT_WALL_ID },
+			{ { 1.f, 0.f }, position[i].x + radius[i] - right_wall, RIGHT_WALL_ID }
+		};
+		for (const Plane& plane : planes)
+		{
+			if (plane.penetration <= 0.f)
+				continue;
+			Contact contact;
+			contact.a = i;
+			contact.b = NO_BODY;
+			contact.normal = plane.normal;
+			contact.penetration = plane.penetration;
+			contact.friction = body.friction;
+			contact.restitution = body.restitution;
+			contact.key = contact_key(ids[i], plane.id);
+			contacts.push_back(contact);
+		}
+	}
+}
+
+void RigidBodySolver::build_islands()
+{
+	const unsigned int count = (unsigned int)position.size();
+
+	// Union the awake bodies of all contacts between two movable bodies
+	parent.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		parent[i] = i;
+	for (const Contact& contact : contacts)
+	{
+		if (contact.b == NO_BODY || inverse_mass[contact.a] == 0.f || inverse_mass[contact.b] == 0.f)
+			continue;
+		const unsigned int root_a = find_root(contact.a);
+		const unsigned int root_b = find_root(contact.b);
+		if (root_a != root_b)
+			parent[max(root_a, root_b)] = min(root_a, root_b);
+	}
+
+	// Number the islands in body order, immovable and sleeping bodies belong to none
+	island_of_body.assign(count, NO_BODY);
+	unsigned int island_count = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (asleep[i])
+			continue;
+		const unsigned int root = find_root(i);
+		if (island_of_body[root] == NO_BODY)
+			island_of_body[root] = island_count++;
+		island_of_body[i] = island_of_body[root];
+	}
+
+	// Counting sort of the bodies and contacts by island, stable so that the solve order
+	// only depends on the scene
+	island_body_start.assign(island_count + 1, 0);
+	island_contact_start.assign(island_count + 1, 0);
+	for (unsigned int i = 0; i < count; i++)
+		if (island_of_body[i] != NO_BODY)
+			island_body_start[island_of_body[i] + 1]++;
+	auto contact_island = [&](const Contact& contact) {
+		return island_of_body[contact.a] != NO_BODY ? island_of_body[contact.a] : island_of_body[contact.b];
+	};
+	for (const Contact& contact : contacts)
+		island_contact_start[contact_island(contact) + 1]++;
+	for (unsigned int island = 0; island < island_count; island++)
+	{
+		island_body_start[island + 1] += island_body_start[island];
+		island_contact_start[island + 1] += island_contact_start[island];
+	}
+
+	island_bodies.resize(island_body_start.back());
+	fill.assign(island_body_start.begin(), island_body_start.end() - 1);
+	for (unsigned int i = 0; i < count; i++)
+		if (island_of_body[i] != NO_BODY)
+			island_bodies[fill[island_of_body[i]]++] = i;
+
+	island_contacts.resize(island_contact_start.back());
+	fill.assign(island_contact_start.begin(), island_contact_start.end() - 1);
+	for (unsigned int c = 0; c < contacts.size(); c++)
+		island_contacts[fill[contact_island(contacts[c])]++] = c;
+
+	stats.islands = island_count;
+	stats.largest_island = 0;
+	for (unsigned int island = 0; island < island_count; island++)
+		stats.largest_island = max(stats.largest_island, island_body_start[island + 1] - island_body_start[island]);
+}
+
+void RigidBodySolver::solve_island(unsigned int island, float dt)
+{
+	const unsigned int* body_begin = island_bodies.data() + island_body_start[island];
+	const unsigned int* body_end = island_bodies.data() + island_body_start[island + 1];
+	const unsigned int* contact_begin = island_contacts.data() + island_contact_start[island];
+	const unsigned int* contact_end = island_contacts.data() + island_contact_start[island + 1];
+
+	// Applies the impulse to a and its opposite to b, the offsets point from the centers
+	// to the contact point
+	auto apply_impulse = [&](const Contact& contact, vec2 offset_a, vec2 offset_b, vec2 impulse) {
+		// immovable bodies are shared between islands, they must not be written
+		if (inverse_mass[contact.a] != 0.f)
+		{
+			velocity[contact.a] -= inverse_mass[contact.a] * impulse;
+			angular_velocity[contact.a] -= inverse_inertia[contact.a] * cross(offset_a, impulse);
+		}
+		if (contact.b != NO_BODY && inverse_mass[contact.b] != 0.f)
+		{
+			velocity[contact.b] += inverse_mass[contact.b] * impulse;
+			angular_velocity[contact.b] += inverse_inertia[contact.b] * cross(offset_b, impulse);
+		}
+	};
+	auto relative_velocity = [&](const Contact& contact, vec2 offset_a, vec2 offset_b) {
+		vec2 v = -velocity[contact.a] - cross(angular_velocity[contact.a], offset_a);
+		if (contact.b != NO_BODY)
+			v += velocity[contact.b] + cross(angular_velocity[contact.b], offset_b);
+		return v;
+	};
+	auto offsets = [&](const Contact& contact, vec2& offset_a, vec2& offset_b) {
+		offset_a = radius[contact.a] * contact.normal;
+		offset_b = contact.b != NO_BODY ? -radius[contact.b] * contact.normal : vec2(0.f);
+	};
+
+	// Effective masses, bias and warm start
+	for (const unsigned int* c = contact_begin; c != contact_end; c++)
+	{
+		Contact& contact = contacts[*c];
+		vec2 offset_a, offset_b;
+		offsets(contact, offset_a, offset_b);
+		const vec2 tangent = { -contact.normal.y, contact.normal.x };
+
+		float mass_sum = inverse_mass[contact.a];
+		float rotational_sum = inverse_inertia[contact.a] * dot(offset_a, offset_a);
+		if (contact.b != NO_BODY)
+		{
+			mass_sum += inverse_mass[contact.b];
+			rotational_sum += inverse_inertia[contact.b] * dot(offset_b, offset_b);
+		}
+		// the offsets are parallel to the normal, rotation only resists tangential impulses
+		contact.mass_normal = mass_sum > 0.f ? 1.f / mass_sum : 0.f;
+		contact.mass_tangent = mass_sum + rotational_sum > 0.f ? 1.f / (mass_sum + rotational_sum) : 0.f;
+
+		const float approach = -dot(relative_velocity(contact, offset_a, offset_b), contact.normal);
+		const float bounce = approach > RESTITUTION_VELOCITY ? contact.restitution * approach : 0.f;
+		contact.bias = max(bounce, BAUMGARTE / dt * max(0.f, contact.penetration - PENETRATION_SLOP));
+
+		const CachedImpulse search = { contact.key, 0.f, 0.f };
+		auto cached = std::lower_bound(impulse_cache.begin(), impulse_cache.end(), search);
+		contact.warm_started = cached != impulse_cache.end() && cached->key == contact.key;
+		if (contact.warm_started)
+		{
+			contact.normal_impulse = cached->normal_impulse;
+			contact.tangent_impulse = cached->tangent_impulse;
+			apply_impulse(contact, offset_a, offset_b, contact.normal_impulse * contact.normal + contact.tangent_impulse * tangent);
+		}
+		else
+		{
+			contact.normal_impulse = 0.f;
+			contact.tangent_impulse = 0.f;
+		}
+	}
+
+	// Sequential impulses with clamped accumulated impulses, the normal points from a to
+	// b so approaching bodies have a positive normal velocity here
+	for (int iteration = 0; iteration < velocity_iterations; iteration++)
+	{
+		for (const unsigned int* c = contact_begin; c != contact_end; c++)
+		{
+			Contact& contact = contacts[*c];
+			vec2 offset_a, offset_b;
+			offsets(contact, offset_a, offset_b);
+			const vec2 tangent = { -contact.normal.y, contact.normal.x };
+
+			const float approach = -dot(relative_velocity(contact, offset_a, offset_b), contact.normal);
+			const float old_normal = contact.normal_impulse;
+			contact.normal_impulse = max(0.f, old_normal + contact.mass_normal * (approach + contact.bias));
+			apply_impulse(contact, offset_a, offset_b, (contact.normal_impulse - old_normal) * contact.normal);
+
+			const float slide = dot(relative_velocity(contact, offset_a, offset_b), tangent);
+			const float max_friction = contact.friction * contact.normal_impulse;
+			const float old_tangent = contact.tangent_impulse;
+			contact.tangent_impulse = clamp(old_tangent - contact.mass_tangent * slide, -max_friction, max_friction);
+			apply_impulse(contact, offset_a, offset_b, (contact.tangent_impulse - old_tangent) * tangent);
+		}
+	}
+
+	// Integrate positions and put the island to sleep once all of its bodies are still
+	float island_still_time = SLEEP_SECONDS;
+	for (const unsigned int* b = body_begin; b != body_end; b++)
+	{
+		const unsigned int i = *b;
+		position[i] += dt * velocity[i];
+		angle[i] += dt * angular_velocity[i];
+		const bool still = dot(velocity[i], velocity[i]) < SLEEP_LINEAR_VELOCITY * SLEEP_LINEAR_VELOCITY &&
+			abs(angular_velocity[i]) < SLEEP_ANGULAR_VELOCITY;
+		still_time[i] = still ? still_time[i] + dt : 0.f;
+		island_still_time = min(island_still_time, still_time[i]);
+	}
+	if (island_still_time >= SLEEP_SECONDS)
+	{
+		for (const unsigned int* b = body_begin; b != body_end; b++)
+		{
+			asleep[*b] = true;
+			velocity[*b] = vec2(0.f);
+			angular_velocity[*b] = 0.f;
+		}
+	}
+}
+
+void RigidBodySolver::step(float elapsed_ms)
+{
+	const float dt = elapsed_ms / 1000.f;
+	stats = RigidBodyStats();
+	ComponentContainer<RigidBody>& rigid_bodies = registry.rigidBodies;
+	const unsigned int count = (unsigned int)rigid_bodies.size();
+	stats.bodies = count;
+	if (count == 0 || dt <= 0.f)
+		return;
+
+	// Gather
+	position.resize(count);
+	velocity.resize(count);
+	angle.resize(count);
+	angular_velocity.resize(count);
+	inverse_mass.resize(count);
+	inverse_inertia.resize(count);
+	radius.resize(count);
+	still_time.resize(count);
+	asleep.resize(count);
+	ids.resize(count);
+	aabb_min.resize(count);
+	aabb_max.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const RigidBody& body = rigid_bodies.components[i];
+		const Entity entity = rigid_bodies.entities[i];
+		const Motion& motion = registry.motions.get(entity);
+		position[i] = motion.position;
+		velocity[i] = motion.velocity;
+		angle[i] = motion.angle;
+		angular_velocity[i] = body.angular_velocity;
+		inverse_mass[i] = body.inverse_mass;
+		// solid disc, I = m r^2 / 2
+		inverse_inertia[i] = body.radius > 0.f ? 2.f * body.inverse_mass / (body.radius * body.radius) : 0.f;
+		radius[i] = body.radius;
+		still_time[i] = body.still_time;
+		// a velocity written from outside wakes the body up
+		asleep[i] = body.inverse_mass == 0.f || (body.asleep && velocity[i] == vec2(0.f));
+		ids[i] = (unsigned int)Entity(entity);
+	}
+
+	// Gravity and damping, then contacts at the current positions
+	const float linear_damping = 1.f / (1.f + dt * LINEAR_DAMPING);
+	const float angular_damping = 1.f / (1.f + dt * ANGULAR_DAMPING);
+	bool any_awake = false;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (asleep[i])
+			continue;
+		velocity[i] = linear_damping * (velocity[i] + dt * gravity);
+		angular_velocity[i] *= angular_damping;
+		any_awake = true;
+	}
+	// Nothing can touch a sleeping body if everything sleeps
+	if (!any_awake)
+		return;
+	find_contacts();
+	build_islands();
+
+	// Islands only touch their own bodies and contacts
+	jobs.parallel_for(stats.islands, 16, [&](size_t begin, size_t end) {
+		for (size_t island = begin; island < end; island++)
+			solve_island((unsigned int)island, dt);
+	});
+
+	// Remember the impulses for the next step
+	impulse_cache.resize(contacts.size());
+	for (size_t c = 0; c < contacts.size(); c++)
+	{
+		const Contact& contact = contacts[c];
+		impulse_cache[c] = { contact.key, contact.normal_impulse, contact.tangent_impulse };
+		stats.warm_started += contact.warm_started;
+	}
+	std::sort(impulse_cache.begin(), impulse_cache.end());
+
+	// Scatter
+	for (unsigned int i = 0; i < count; i++)
+	{
+		RigidBody& body = rigid_bodies.components[i];
+		Motion& motion = registry.motions.get(rigid_bodies.entities[i]);
+		motion.position = position[i];
+		motion.velocity = velocity[i];
+		motion.angle = angle[i];
+		body.angular_velocity = angular_velocity[i];
+		body.still_time = still_time[i];
+		body.asleep = asleep[i] && body.inverse_mass != 0.f;
+		stats.awake_bodies += !asleep[i];
+	}
+	stats.contacts = (unsigned int)contacts.size();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "components.hpp"
+#include "broadphase_grid.hpp"
+#include "job_system.hpp"
+
+// Counters of the last RigidBodySolver::step
+struct RigidBodyStats
+{
+	unsigned int bodies = 0;
+	unsigned int awake_bodies = 0;
+	unsigned int contacts = 0;
+	unsigned int warm_started = 0; // contacts that reused the impulses of the last step
+	unsigned int islands = 0;
+	unsigned int largest_island = 0; // in bodies
+};
+
+// Sequential impulse solver for the circular RigidBody entities, they collide with each
+// other and with a floor and two side walls. Contact impulses are cached by entity pair
+// and used as the starting guess in the next step (warm starting), which lets stacks
+// come to rest in few iterations. Bodies touching each other form islands that are
+// solved independently on the job system, an island that stays still long enough falls
+// asleep and costs nothing until something awake touches it. The results don't depend
+// on the number of threads.
+class RigidBodySolver
+{
+public:
+	RigidBodySolver(JobSystem& jobs = get_job_system());
+
+	// Simulates all registry.rigidBodies for elapsed_ms and writes their Motion
+	void step(float elapsed_ms);
+
+	// Walls at area_min.x and area_max.x, the floor at area_max.y, nothing above. The
+	// contact grid covers the box, bodies outside of it are only slower to test.
+	void set_bounds(vec2 area_min, vec2 area_max, float cell_size = 32.f);
+
+	const RigidBodyStats& get_stats() const { return stats; }
+
+	vec2 gravity = { 0.f, 980.f }; // pixels per second squared, y points down
+	int velocity_iterations = 8;
+
+private:
+	static const unsigned int NO_BODY = ~0u;
+
+	struct Contact
+	{
+		unsigned int a;
+		unsigned int b; // NO_BODY for the floor and the walls
+		vec2 normal; // from a to b
+		float penetration;
+		float friction;
+		float restitution;
+		uint64_t key;
+
+		// filled in by the island solve
+		float mass_normal;
+		float mass_tangent;
+		float bias;
+		float normal_impulse;
+		float tangent_impulse;
+		bool warm_started;
+	};
+
+	// Accumulated impulses of a contact, kept sorted by key for the next step
+	struct CachedImpulse
+	{
+		uint64_t key;
+		float normal_impulse;
+		float tangent_impulse;
+		bool operator<(const CachedImpulse& other) const { return key < other.key; }
+	};
+
+	void find_contacts();
+	void build_islands();
+	void solve_island(unsigned int island, float dt);
+	void wake(unsigned int body);
+	unsigned int find_root(unsigned int body);
+
+	JobSystem& jobs;
+	BroadphaseGrid grid;
+	float left_wall = 0.f;
+	float right_wall = 0.f;
+	float floor = 0.f;
+	RigidBodyStats stats;
+
+	// Structure of arrays copy of the bodies, indexed like registry.rigidBodies
+	std::vector<vec2> position;
+	std::vector<vec2> velocity;
+	std::vector<float> angle;
+	std::vector<float> angular_velocity;
+	std::vector<float> inverse_mass;
+	std::vector<float> inverse_inertia;
+	std::vector<float> radius;
+	std::vector<float> still_time;
+	std::vector<char> asleep; // also set for immovable bodies, the grid skips pairs of two
+	std::vector<unsigned int> ids;
+	std::vector<vec2> aabb_min;
+	std::vector<vec2> aabb_max;
+
+	std::vector<Contact> contacts;
+	std::vector<CachedImpulse> impulse_cache;
+
+	// Islands as ranges into the body and contact lists sorted by island
+	std::vector<unsigned int> parent; // union-find forest
+	std::vector<unsigned int> island_of_body;
+	std::vector<unsigned int> island_body_start;
+	std::vector<unsigned int> island_bodies;
+	std::vector<unsigned int> island_contact_start;
+	std::vector<unsigned int> island_contacts;
+	std::vector<unsigned int> fill;
+};
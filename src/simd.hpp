@@ -0,0 +1,75 @@
+#pragma once
+
+// Four float lanes for data parallel inner loops such as the wind grid solve.
+// Compiles to SSE where the target has it and to plain arrays otherwise, so the loops are
+// written once. Loads and stores are unaligned, arrays need no special allocation.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define SIMD_SSE 0
+#include <algorithm>
+#include <cmath>
+#endif
+
+struct float4
+{
+#if SIMD_SSE
+	__m128 v;
+	float4() : v(_mm_setzero_ps()) {}
+	explicit float4(__m128 value) : v(value) {}
+	explicit float4(float value) : v(_mm_set1_ps(value)) {}
+
+	static float4 load(const float* p) { return float4(_mm_loadu_ps(p)); }
+	void store(float* p) const { _mm_storeu_ps(p, v); }
+
+	friend float4 operator+(float4 a, float4 b) { return float4(_mm_add_ps(a.v, b.v)); }
+	friend float4 operator-(float4 a, float4 b) { return float4(_mm_sub_ps(a.v, b.v)); }
+	friend float4 operator*(float4 a, float4 b) { return float4(_mm_mul_ps(a.v, b.v)); }
+	friend float4 operator/(float4 a, float4 b) { return float4(_mm_div_ps(a.v, b.v)); }
+	friend float4 min(float4 a, float4 b) { return float4(_mm_min_ps(a.v, b.v)); }
+	friend float4 max(float4 a, float4 b) { return float4(_mm_max_ps(a.v, b.v)); }
+	friend float4 sqrt(float4 a) { return float4(_mm_sqrt_ps(a.v)); }
+	// Lanes of 'a' where mask is set, 'b' elsewhere, masks come from the comparisons
+	friend float4 select(float4 mask, float4 a, float4 b)
+	{
+		return float4(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+	}
+	friend float4 operator<(float4 a, float4 b) { return float4(_mm_cmplt_ps(a.v, b.v)); }
+	friend float4 operator>(float4 a, float4 b) { return float4(_mm_cmpgt_ps(a.v, b.v)); }
+	// Sum of all lanes
+	float sum() const
+	{
+		float lanes[4];
+		store(lanes);
+		return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	}
+#else
+	float f[4];
+	float4() : f{ 0.f, 0.f, 0.f, 0.f } {}
+	explicit float4(float value) : f{ value, value, value, value } {}
+
+	static float4 load(const float* p) { float4 r; for (int i = 0; i < 4; i++) r.f[i] = p[i]; return r; }
+	void store(float* p) const { for (int i = 0; i < 4; i++) p[i] = f[i]; }
+
+	template <class Op>
+	static float4 lanewise(float4 a, float4 b, Op op) { float4 r; for (int i = 0; i < 4; i++) r.f[i] = op(a.f[i], b.f[i]); return r; }
+
+	friend float4 operator+(float4 a, float4 b) { return lanewise(a, b, [](float x, float y) { return x + y; }); }
+	friend float4 operator-(float4 a, float4 b) { return lanewise(a, b, [](float x, float y) { return x - y; }); }
+	friend float4 operator*(float4 a, float4 b) { return lanewise(a, b, [](float x, float y) { return x * y; }); }
+	friend float4 operator/(float4 a, float4 b) { return lanewise(a, b, [](float x, float y) { return x / y; }); }
+	friend float4 min(float4 a, float4 b) { return lanewise(a, b, [](float x, float y) { return std::min(x, y); }); }
+	friend float4 max(float4 a, float4 b) { return lanewise(a, b, [](float x, float y) { return std::max(x, y); }); }
+	friend float4 sqrt(float4 a) { float4 r; for (int i = 0; i < 4; i++) r.f[i] = std::sqrt(a.f[i]); return r; }
+	// Comparisons give 1 or 0 per lane, select picks 'a' where the mask is non-zero
+	friend float4 select(float4 mask, float4 a, float4 b) { float4 r; for (int i = 0; i < 4; i++) r.f[i] = mask.f[i] != 0.f ? a.f[i] : b.f[i]; return r; }
+	friend float4 operator<(float4 a, float4 b) { return lanewise(a, b, [](float x, float y) { return x < y ? 1.f : 0.f; }); }
+	friend float4 operator>(float4 a, float4 b) { return lanewise(a, b, [](float x, float y) { return x > y ? 1.f : 0.f; }); }
+	float sum() const { return (f[0] + f[1]) + (f[2] + f[3]); }
+#endif
+
+	float4& operator+=(float4 other) { return *this = *this + other; }
+	float4& operator-=(float4 other) { return *this = *this - other; }
+	float4& operator*=(float4 other) { return *this = *this * other; }
+};
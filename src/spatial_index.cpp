@@ -0,0 +1,226 @@
+// internal
+#include "spatial_index.hpp"
+
+// stlib
+#include <limits>
+
+void SpatialIndex::update(const Entity* entities_arg, const Motion* motions, const float* radii_arg, const uint32_t* layers_arg, unsigned int count)
+{
+	// assign and resize re-use the capacity of the previous steps
+	entities.assign(entities_arg, entities_arg + count);
+	positions.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		positions[i] = motions[i].position;
+	radii.assign(radii_arg, radii_arg + count);
+	layers.assign(layers_arg, layers_arg + count);
+}
+
+template <class Visitor>
+void SpatialIndex::for_each_body_in_box(vec2 box_min, vec2 box_max, Visitor visit) const
+{
+	ivec2 query_min, query_max;
+	grid.get_cell_range(box_min, box_max, query_min, query_max);
+	for (int y = query_min.y; y <= query_max.y; y++)
+	{
+		for (int x = query_min.x; x <= query_max.x; x++)
+		{
+			for (unsigned int e = grid.cell_begin(x, y); e < grid.cell_end(x, y); e++)
+			{
+				const unsigned int body = grid.entry(e);
+				// A body spanning several cells is only visited in the first cell shared
+				// by its own cell range and the query range
+				ivec2 body_min, body_max;
+				grid.get_cell_range(grid.get_min(body), grid.get_max(body), body_min, body_max);
+				const ivec2 owner = max(body_min, query_min);
+				if (owner.x == x && owner.y == y)
+					visit(body);
+			}
+		}
+	}
+}
+
+size_t SpatialIndex::query_radius(vec2 center, float radius, uint32_t layer_filter, Entity* out, size_t capacity) const
+{
+	size_t count = 0;
+	for_each_body_in_box(center - radius, center + radius, [&](unsigned int body) {
+		if ((layers[body] & layer_filter) == 0 || count == capacity)
+			return;
+		const vec2 d = positions[body] - center;
+		const float r = radius + radii[body];
+		if (dot(d, d) < r * r)
+			out[count++] = entities[body];
+	});
+	return count;
+}
+
+size_t SpatialIndex::query_aabb(vec2 box_min, vec2 box_max, uint32_t layer_filter, Entity* out, size_t capacity) const
+{
+	size_t count = 0;
+	for_each_body_in_box(box_min, box_max, [&](unsigned int body) {
+		if ((layers[body] & layer_filter) == 0 || count == capacity)
+			return;
+		// distance from the circle center to the closest point of the box
+		const vec2 d = positions[body] - clamp(positions[body], box_min, box_max);
+		if (dot(d, d) < radii[body] * radii[body])
+			out[count++] = entities[body];
+	});
+	return count;
+}
+
+bool SpatialIndex::raycast(vec2 origin, vec2 direction, float max_distance, uint32_t layer_filter, RaycastHit& out_hit) const
+{
+	const float length = sqrt(dot(direction, direction));
+	if (length < 1e-6f)
+		return false;
+	direction /= length;
+
+	// Clip the ray against the grid rectangle (slab test)
+	const float cell_size = grid.get_cell_size();
+	const ivec2 dims = grid.get_dims();
+	const vec2 grid_min = grid.get_origin();
+	const vec2 grid_max = grid_min + vec2(dims) * cell_size;
+	float t_enter = 0.f;
+	float t_exit = max_distance;
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (abs(direction[axis]) < 1e-6f)
+		{
+			if (origin[axis] < grid_min[axis] || origin[axis] > grid_max[axis])
+				return false;
+			continue;
+		}
+		float t0 = (grid_min[axis] - origin[axis]) / direction[axis];
+		float t1 = (grid_max[axis] - origin[axis]) / direction[axis];
+		t_enter = max(t_enter, min(t0, t1));
+		t_exit = min(t_exit, max(t0, t1));
+	}
+	if (t_enter > t_exit)
+		return false;
+
+	// Walk the cells along the ray (Amanatides & Woo)
+	const vec2 start = origin + t_enter * direction;
+	ivec2 cell = clamp(ivec2(floor((start - grid_min) / cell_size)), ivec2(0), dims - 1);
+	ivec2 cell_step;
+	vec2 t_max, t_delta;
+	for (int axis = 0; axis < 2; axis++)
+	{
+		cell_step[axis] = direction[axis] >= 0.f ? 1 : -1;
+		if (abs(direction[axis]) < 1e-6f)
+		{
+			t_max[axis] = std::numeric_limits<float>::max();
+			t_delta[axis] = std::numeric_limits<float>::max();
+			continue;
+		}
+		const float boundary = grid_min[axis] + (cell[axis] + (cell_step[axis] > 0 ? 1 : 0)) * cell_size;
+		t_max[axis] = (boundary - origin[axis]) / direction[axis];
+		t_delta[axis] = cell_size / abs(direction[axis]);
+	}
+
+	float best = max_distance;
+	bool found = false;
+	while (cell.x >= 0 && cell.y >= 0 && cell.x < dims.x && cell.y < dims.y)
+	{
+		for (unsigned int e = grid.cell_begin(cell.x, cell.y); e < grid.cell_end(cell.x, cell.y); e++)
+		{
+			const unsigned int body = grid.entry(e);
+			if ((layers[body] & layer_filter) == 0)
+				continue;
+			// ray vs. bounding circle
+			const vec2 m = origin - positions[body];
+			const float b = dot(m, direction);
+			const float c = dot(m, m) - radii[body] * radii[body];
+			if (c > 0.f && b > 0.f)
+				continue; // outside and pointing away
+			const float discriminant = b * b - c;
+			if (discriminant < 0.f)
+				continue;
+			const float t = max(0.f, -b - sqrt(discriminant));
+			if (t <= best)
+			{
+				best = t;
+				found = true;
+				out_hit.entity = entities[body];
+				out_hit.distance = t;
+				out_hit.point = origin + t * direction;
+			}
+		}
+
+		// A hit point lies in the cell it is binned in, so nothing beyond this cell can be closer
+		const float cell_exit = min(t_max.x, t_max.y);
+		if ((found && best <= cell_exit) || cell_exit > t_exit)
+			break;
+		if (t_max.x < t_max.y)
+		{
+			cell.x += cell_step.x;
+			t_max.x += t_delta.x;
+		}
+		else
+		{
+			cell.y += cell_step.y;
+			t_max.y += t_delta.y;
+		}
+	}
+	return found;
+}
+
+size_t SpatialIndex::nearest_k(vec2 position, size_t k, uint32_t layer_filter, Entity* out_entities, float* out_distances) const
+{
+	if (k == 0)
+		return 0;
+
+	const float cell_size = grid.get_cell_size();
+	const ivec2 dims = grid.get_dims();
+	ivec2 center, unused;
+	grid.get_cell_range(position, position, center, unused);
+
+	size_t count = 0;
+	const int max_ring = max(dims.x, dims.y);
+	for (int ring = 0; ring <= max_ring; ring++)
+	{
+		// Visit the cells at Chebyshev distance 'ring' from the center cell
+		for (int y = center.y - ring; y <= center.y + ring; y++)
+		{
+			if (y < 0 || y >= dims.y)
+				continue;
+			const bool full_row = (y == center.y - ring || y == center.y + ring);
+			for (int x = center.x - ring; x <= center.x + ring; x += full_row ? 1 : 2 * max(ring, 1))
+			{
+				if (x < 0 || x >= dims.x)
+					continue;
+				for (unsigned int e = grid.cell_begin(x, y); e < grid.cell_end(x, y); e++)
+				{
+					const unsigned int body = grid.entry(e);
+					if ((layers[body] & layer_filter) == 0)
+						continue;
+					const vec2 d = positions[body] - position;
+					const float distance = sqrt(dot(d, d));
+					if (count == k && distance >= out_distances[k - 1])
+						continue;
+					// bodies spanning several cells are met more than once
+					bool duplicate = false;
+					const unsigned int id = (unsigned int)Entity(entities[body]);
+					for (size_t i = 0; i < count && !duplicate; i++)
+						duplicate = (unsigned int)out_entities[i] == id;
+					if (duplicate)
+						continue;
+
+					// insertion into the sorted result list
+					size_t i = count < k ? count++ : k - 1;
+					while (i > 0 && out_distances[i - 1] > distance)
+					{
+						out_entities[i] = out_entities[i - 1];
+						out_distances[i] = out_distances[i - 1];
+						i--;
+					}
+					out_entities[i] = entities[body];
+					out_distances[i] = distance;
+				}
+			}
+		}
+
+		// Every body in the next ring is at least ring * cell_size away
+		if (count == k && out_distances[k - 1] <= ring * cell_size)
+			break;
+	}
+	return count;
+}
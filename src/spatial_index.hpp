@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "broadphase_grid.hpp"
+#include "components.hpp"
+
+// Result of SpatialIndex::raycast
+struct RaycastHit
+{
+	Entity entity;
+	float distance = 0.f; // along the ray, from its origin to the surface of the bounding circle
+	vec2 point = { 0, 0 };
+};
+
+// Neighborhood queries over the bodies of the last physics step, answered from the
+// broadphase grid of the PhysicsSystem that owns the index. Bodies are represented by
+// their bounding circle and filtered by COLLISION_LAYER bits, any body with at least one
+// layer in 'layer_filter' matches. Results are written into caller-provided buffers and
+// no query allocates; the queries are const and can run concurrently.
+class SpatialIndex
+{
+public:
+	SpatialIndex(const BroadphaseGrid& grid) : grid(grid) {}
+
+	// Takes a snapshot of the bodies the grid was just built from, all arrays are indexed
+	// like the grid bodies
+	void update(const Entity* entities, const Motion* motions, const float* radii, const uint32_t* layers, unsigned int count);
+
+	// Bodies whose bounding circle overlaps the circle, returns the number written to 'out'
+	// (at most 'capacity', further matches are dropped)
+	size_t query_radius(vec2 center, float radius, uint32_t layer_filter, Entity* out, size_t capacity) const;
+
+	// Bodies whose bounding circle overlaps the axis-aligned box
+	size_t query_aabb(vec2 box_min, vec2 box_max, uint32_t layer_filter, Entity* out, size_t capacity) const;
+
+	// Closest body whose bounding circle is hit by the ray, direction needs not be normalized
+	bool raycast(vec2 origin, vec2 direction, float max_distance, uint32_t layer_filter, RaycastHit& out_hit) const;
+
+	// Up to k bodies closest to 'position' by center distance, sorted from near to far.
+	// Both output buffers need room for k elements, returns the number of bodies found.
+	size_t nearest_k(vec2 position, size_t k, uint32_t layer_filter, Entity* out_entities, float* out_distances) const;
+
+	unsigned int size() const { return (unsigned int)entities.size(); }
+
+private:
+	// Calls visit(body) once for every body binned into the cells covered by the box
+	template <class Visitor>
+	void for_each_body_in_box(vec2 box_min, vec2 box_max, Visitor visit) const;
+
+	const BroadphaseGrid& grid;
+	std::vector<Entity> entities;
+	std::vector<vec2> positions;
+	std::vector<float> radii;
+	std::vector<uint32_t> layers;
+};
@@ -0,0 +1,209 @@
+// internal
+#include "steering.hpp"
+#include "simd.hpp"
+
+void SteeringBatch::resize(size_t count)
+{
+	std::vector<float>* arrays[] = {
+		&position_x, &position_y, &velocity_x, &velocity_y,
+		&target_x, &target_y, &target_velocity_x, &target_velocity_y, &target_weight,
+		&threat_x, &threat_y, &threat_velocity_x, &threat_velocity_y, &threat_weight,
+		&flow_x, &flow_y, &separation_x, &separation_y, &alignment_x, &alignment_y, &cohesion_x, &cohesion_y };
+	for (std::vector<float>* array : arrays)
+		array->assign(count, 0.f);
+}
+
+void compute_separation(SteeringBatch& batch, const NeighborGrid& grid, float radius, size_t begin, size_t end)
+{
+	const float radius_squared = radius * radius;
+	const float* px = batch.position_x.data();
+	const float* py = batch.position_y.data();
+	for (size_t i = begin; i < end; i++)
+	{
+		float push_x = 0.f, push_y = 0.f;
+		grid.for_each_near({ px[i], py[i] }, radius, [&](unsigned int j) {
+			const float dx = px[i] - px[j];
+			const float dy = py[i] - py[j];
+			const float distance_squared = dx * dx + dy * dy;
+			if (j == i || distance_squared >= radius_squared || distance_squared < 1e-6f)
+				return;
+			const float distance = sqrt(distance_squared);
+			// unit vector away from the neighbor, weighted by how close it is
+			const float strength = (1.f - distance / radius) / distance;
+			push_x += dx * strength;
+			push_y += dy * strength;
+		});
+		batch.separation_x[i] = push_x;
+		batch.separation_y[i] = push_y;
+	}
+}
+
+void compute_flocking(SteeringBatch& batch, const NeighborGrid& grid, const SteeringArchetype& archetype,
+	size_t begin, size_t end, size_t flock_begin, size_t flock_end)
+{
+	const float separation_squared = archetype.separation_radius * archetype.separation_radius;
+	const float neighbor_squared = archetype.neighbor_radius * archetype.neighbor_radius;
+	const float radius = max(archetype.separation_radius, archetype.neighbor_radius);
+	const float* px = batch.position_x.data();
+	const float* py = batch.position_y.data();
+	const float* vx = batch.velocity_x.data();
+	const float* vy = batch.velocity_y.data();
+	for (size_t i = begin; i < end; i++)
+	{
+		float push_x = 0.f, push_y = 0.f;
+		float velocity_x = 0.f, velocity_y = 0.f, center_x = 0.f, center_y = 0.f;
+		unsigned int mates = 0;
+		grid.for_each_near({ px[i], py[i] }, radius, [&](unsigned int j) {
+			const float dx = px[i] - px[j];
+			const float dy = py[i] - py[j];
+			const float distance_squared = dx * dx + dy * dy;
+			if (j == i)
+				return;
+			if (distance_squared < separation_squared && distance_squared >= 1e-6f)
+			{
+				const float distance = sqrt(distance_squared);
+				const float strength = (1.f - distance / archetype.separation_radius) / distance;
+				push_x += dx * strength;
+				push_y += dy * strength;
+			}
+			if (distance_squared < neighbor_squared && j >= flock_begin && j < flock_end)
+			{
+				velocity_x += vx[j];
+				velocity_y += vy[j];
+				center_x += px[j];
+				center_y += py[j];
+				mates++;
+			}
+		});
+		batch.separation_x[i] = push_x;
+		batch.separation_y[i] = push_y;
+		const float inverse_mates = mates > 0 ? 1.f / mates : 0.f;
+		batch.alignment_x[i] = mates > 0 ? velocity_x * inverse_mates - vx[i] : 0.f;
+		batch.alignment_y[i] = mates > 0 ? velocity_y * inverse_mates - vy[i] : 0.f;
+		batch.cohesion_x[i] = mates > 0 ? center_x * inverse_mates - px[i] : 0.f;
+		batch.cohesion_y[i] = mates > 0 ? center_y * inverse_mates - py[i] : 0.f;
+	}
+}
+
+namespace {
+	// Four 2D vectors
+	struct vec2x4
+	{
+		float4 x, y;
+	};
+
+	vec2x4 operator+(vec2x4 a, vec2x4 b) { return { a.x + b.x, a.y + b.y }; }
+	vec2x4 operator-(vec2x4 a, vec2x4 b) { return { a.x - b.x, a.y - b.y }; }
+	vec2x4 operator*(vec2x4 a, float4 s) { return { a.x * s, a.y * s }; }
+
+	vec2x4 load2(const std::vector<float>& x, const std::vector<float>& y, size_t i)
+	{
+		return { float4::load(x.data() + i), float4::load(y.data() + i) };
+	}
+
+	float4 length(vec2x4 a)
+	{
+		return sqrt(a.x * a.x + a.y * a.y);
+	}
+
+	// 1 / length, 0 for (nearly) zero vectors instead of infinity
+	float4 inverse_length(float4 length)
+	{
+		const float4 epsilon(1e-4f);
+		return select(length > epsilon, float4(1.f) / max(length, epsilon), float4(0.f));
+	}
+
+	// Scales vectors longer than 'limit' down to it
+	vec2x4 clamp_length(vec2x4 a, float4 limit)
+	{
+		const float4 l = length(a);
+		return a * select(l > limit, limit * inverse_length(l), float4(1.f));
+	}
+}
+
+// Elapsed time per agent from 'agent_elapsed_ms' if not null, 'elapsed_ms' for all otherwise
+static void steer_agents(const SteeringArchetype& archetype, SteeringBatch& batch, size_t begin, size_t end,
+	const float* agent_elapsed_ms, float elapsed_ms)
+{
+	const float4 max_speed(archetype.max_speed);
+	const float4 max_acceleration_per_ms(archetype.max_acceleration / 1000.f);
+	const float4 inverse_slowing_radius(1.f / archetype.slowing_radius);
+	const float4 inverse_panic_radius(1.f / archetype.panic_radius);
+	const float4 inverse_max_speed(1.f / archetype.max_speed);
+	const float4 max_prediction(archetype.max_prediction);
+	const float4 zero(0.f), one(1.f);
+	const vec2x4 cruise = { float4(archetype.cruise * archetype.cruise_velocity.x), float4(archetype.cruise * archetype.cruise_velocity.y) };
+	const float4 seek_weight(archetype.seek), arrive_weight(archetype.arrive), pursue_weight(archetype.pursue);
+	const float4 flee_weight(archetype.flee), evade_weight(archetype.evade), separation_weight(archetype.separation);
+	const float4 flow_weight(archetype.follow_flow);
+	const float4 alignment_weight(archetype.alignment), cohesion_weight(archetype.cohesion);
+	const float4 inverse_neighbor_radius(1.f / archetype.neighbor_radius);
+	const bool flocking = archetype.flocks();
+
+	for (size_t i = begin; i < end; i += 4)
+	{
+		const vec2x4 position = load2(batch.position_x, batch.position_y, i);
+		const vec2x4 velocity = load2(batch.velocity_x, batch.velocity_y, i);
+
+		// Seek, arrive and pursue the target
+		const vec2x4 target = load2(batch.target_x, batch.target_y, i);
+		const vec2x4 target_velocity = load2(batch.target_velocity_x, batch.target_velocity_y, i);
+		const vec2x4 to_target = target - position;
+		const float4 target_distance = length(to_target);
+		const vec2x4 target_direction = to_target * inverse_length(target_distance);
+		const float4 slow_down = min(one, target_distance * inverse_slowing_radius);
+		const float4 target_lookahead = min(target_distance * inverse_max_speed, max_prediction);
+		const vec2x4 to_intercept = (target + target_velocity * target_lookahead) - position;
+		const vec2x4 intercept_direction = to_intercept * inverse_length(length(to_intercept));
+		const vec2x4 towards_target = target_direction * (seek_weight + arrive_weight * slow_down) +
+			intercept_direction * pursue_weight;
+
+		// Flee and evade the threat, both fade out towards the panic radius
+		const vec2x4 threat = load2(batch.threat_x, batch.threat_y, i);
+		const vec2x4 threat_velocity = load2(batch.threat_velocity_x, batch.threat_velocity_y, i);
+		const vec2x4 from_threat = position - threat;
+		const float4 threat_distance = length(from_threat);
+		const float4 panic = max(zero, one - threat_distance * inverse_panic_radius);
+		const vec2x4 threat_direction = from_threat * inverse_length(threat_distance);
+		const float4 threat_lookahead = min(threat_distance * inverse_max_speed, max_prediction);
+		const vec2x4 from_predicted = position - (threat + threat_velocity * threat_lookahead);
+		const vec2x4 predicted_direction = from_predicted * inverse_length(length(from_predicted));
+		const vec2x4 away_from_threat = (threat_direction * flee_weight + predicted_direction * evade_weight) * panic;
+
+		// Separation is full strength once the summed push reaches 1
+		const vec2x4 push = load2(batch.separation_x, batch.separation_y, i);
+		const vec2x4 separation = clamp_length(push, one);
+		const vec2x4 flow = load2(batch.flow_x, batch.flow_y, i);
+
+		// Alignment is full strength once the velocities differ by max_speed, cohesion once
+		// the center is a neighbor radius away
+		vec2x4 flock = { zero, zero };
+		if (flocking)
+			flock = clamp_length(load2(batch.alignment_x, batch.alignment_y, i) * inverse_max_speed, one) * alignment_weight +
+				clamp_length(load2(batch.cohesion_x, batch.cohesion_y, i) * inverse_neighbor_radius, one) * cohesion_weight;
+
+		const float4 target_weight = float4::load(batch.target_weight.data() + i);
+		const float4 threat_weight = float4::load(batch.threat_weight.data() + i);
+		const vec2x4 desired = clamp_length(cruise +
+			(towards_target * target_weight + away_from_threat * threat_weight + separation * separation_weight +
+				flow * flow_weight + flock) * max_speed,
+			max_speed);
+
+		// Limited acceleration towards the desired velocity
+		const float4 step_ms = agent_elapsed_ms != nullptr ? float4::load(agent_elapsed_ms + i) : float4(elapsed_ms);
+		const float4 max_velocity_change = max_acceleration_per_ms * step_ms;
+		const vec2x4 new_velocity = velocity + clamp_length(desired - velocity, max_velocity_change);
+		new_velocity.x.store(batch.velocity_x.data() + i);
+		new_velocity.y.store(batch.velocity_y.data() + i);
+	}
+}
+
+void steer(const SteeringArchetype& archetype, SteeringBatch& batch, size_t begin, size_t end, float elapsed_ms)
+{
+	steer_agents(archetype, batch, begin, end, nullptr, elapsed_ms);
+}
+
+void steer(const SteeringArchetype& archetype, SteeringBatch& batch, size_t begin, size_t end, const float* agent_elapsed_ms)
+{
+	steer_agents(archetype, batch, begin, end, agent_elapsed_ms, 0.f);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "neighbor_grid.hpp"
+
+// Tuning of one AGENT_ARCHETYPE. Every behavior produces a desired velocity of up to
+// max_speed, the agent steers towards their weighted sum with limited acceleration.
+struct SteeringArchetype
+{
+	float max_speed = 100.f; // pixels per second
+	float max_acceleration = 300.f; // pixels per second squared
+
+	// Weights of the behaviors
+	float cruise = 0.f; // keep moving with cruise_velocity
+	float seek = 0.f; // head for the target
+	float arrive = 0.f; // head for the target, slowing down within slowing_radius
+	float pursue = 0.f; // head for where the target will be
+	float flee = 0.f; // move away from the threat within panic_radius
+	float evade = 0.f; // move away from where the threat will be
+	float separation = 0.f; // keep separation_radius away from other agents
+	float alignment = 0.f; // match the velocity of the flock within neighbor_radius
+	float cohesion = 0.f; // head for the center of the flock within neighbor_radius
+	float follow_flow = 0.f; // follow the flow field towards the target
+
+	vec2 cruise_velocity = { 0, 0 };
+	float slowing_radius = 100.f;
+	float panic_radius = 150.f;
+	float separation_radius = 50.f;
+	float neighbor_radius = 100.f;
+	float max_prediction = 1.f; // seconds pursue and evade look ahead at most
+
+	// Needs compute_flocking instead of compute_separation
+	bool flocks() const { return alignment != 0.f || cohesion != 0.f; }
+};
+
+// Structure of arrays input and output of the steering pass. Agents of an archetype form
+// a contiguous range starting at a multiple of four, the gaps are padding agents with
+// zeros that are computed along and ignored.
+struct SteeringBatch
+{
+	std::vector<float> position_x, position_y;
+	std::vector<float> velocity_x, velocity_y; // read and written
+	// the target of seek, arrive and pursue, target_weight is 0 without target and 1 otherwise
+	std::vector<float> target_x, target_y, target_velocity_x, target_velocity_y, target_weight;
+	// the threat of flee and evade, same as the target
+	std::vector<float> threat_x, threat_y, threat_velocity_x, threat_velocity_y, threat_weight;
+	// unit direction of the flow field at the agent, 0 without one
+	std::vector<float> flow_x, flow_y;
+	// written by compute_separation and compute_flocking
+	std::vector<float> separation_x, separation_y;
+	// written by compute_flocking, the average velocity of the flock mates relative to the
+	// agent's and the offset to their center, 0 without flock mates
+	std::vector<float> alignment_x, alignment_y, cohesion_x, cohesion_y;
+
+	// Resizes all arrays to 'count' (a multiple of four) and zeros them
+	void resize(size_t count);
+	size_t size() const { return position_x.size(); }
+};
+
+// Sums the push away from all agents closer than 'radius' for the agents in
+// [begin, end), 'grid' has to be built from the batch positions. The push of a neighbor
+// falls off linearly to 0 at the radius, the sum is not normalized.
+void compute_separation(SteeringBatch& batch, const NeighborGrid& grid, float radius, size_t begin, size_t end);
+
+// Separation as above plus the alignment and cohesion inputs for the agents in
+// [begin, end). Only the agents in [flock_begin, flock_end), usually the range of the
+// archetype, closer than the neighbor radius count as flock mates. Reads the velocities of
+// the neighbors, so no agent may be steered before all agents of the flock are computed.
+void compute_flocking(SteeringBatch& batch, const NeighborGrid& grid, const SteeringArchetype& archetype,
+	size_t begin, size_t end, size_t flock_begin, size_t flock_end);
+
+// Evaluates all behaviors for the agents in [begin, end), four at a time (begin and end
+// are multiples of four), and writes the new velocities
+void steer(const SteeringArchetype& archetype, SteeringBatch& batch, size_t begin, size_t end, float elapsed_ms);
+// Same with the time every agent accelerates for, indexed like the batch
+void steer(const SteeringArchetype& archetype, SteeringBatch& batch, size_t begin, size_t end, const float* agent_elapsed_ms);
@@ -3,6 +3,7 @@
 
 #include "tiny_ecs.hpp"
 #include "components.hpp"
+#include "alpha_mask.hpp"
 
 class ECSRegistry
 {
@@ -14,9 +15,20 @@ public:
 	// TODO: A1 add a LightUp component
 	ComponentContainer<DeathTimer> deathTimers;
 	ComponentContainer<Motion> motions;
+	ComponentContainer<PreviousMotion> previousMotions;
 	ComponentContainer<Collision> collisions;
+	ComponentContainer<PhysicsBody> physicsBodies;
+	ComponentContainer<RigidBody> rigidBodies;
+	ComponentContainer<Boundary> boundaries;
+	ComponentContainer<OutOfBounds> outOfBounds;
 	ComponentContainer<Player> players;
 	ComponentContainer<Mesh*> meshPtrs;
+	ComponentContainer<AlphaMask*> alphaMaskPtrs;
+	ComponentContainer<AIAgent> aiAgents;
+	ComponentContainer<AIPath> aiPaths;
+	ComponentContainer<Blackboard> blackboards;
+	ComponentContainer<UtilityDecision> utilityDecisions;
+	ComponentContainer<Obstacle> obstacles;
 	ComponentContainer<RenderRequest> renderRequests;
 	ComponentContainer<ScreenState> screenStates;
 	ComponentContainer<Eatable> eatables;
@@ -37,9 +49,20 @@ public:
 		// TODO: A1 add a LightUp component
 		registry_list.push_back(&deathTimers);
 		registry_list.push_back(&motions);
+		registry_list.push_back(&previousMotions);
 		registry_list.push_back(&collisions);
+		registry_list.push_back(&physicsBodies);
+		registry_list.push_back(&rigidBodies);
+		registry_list.push_back(&boundaries);
+		registry_list.push_back(&outOfBounds);
 		registry_list.push_back(&players);
 		registry_list.push_back(&meshPtrs);
+		registry_list.push_back(&alphaMaskPtrs);
+		registry_list.push_back(&aiAgents);
+		registry_list.push_back(&aiPaths);
+		registry_list.push_back(&blackboards);
+		registry_list.push_back(&utilityDecisions);
+		registry_list.push_back(&obstacles);
 		registry_list.push_back(&renderRequests);
 		registry_list.push_back(&screenStates);
 		registry_list.push_back(&eatables);
@@ -0,0 +1,84 @@
+// internal
+#include "utility_ai.hpp"
+#include "tiny_ecs_registry.hpp"
+
+const Entity UtilityCandidate::no_target;
+
+float ResponseCurve::evaluate(float x) const
+{
+	x = clamp(x, 0.f, 1.f);
+	float y;
+	switch (type)
+	{
+	case CURVE::POLYNOMIAL:
+		y = slope * pow(max(0.f, x - x_shift), exponent) + y_shift;
+		break;
+	case CURVE::LOGISTIC:
+		y = 1.f / (1.f + exp(-slope * (x - x_shift))) + y_shift;
+		break;
+	default:
+		y = slope * (x - x_shift) + y_shift;
+		break;
+	}
+	return clamp(y, 0.f, 1.f);
+}
+
+bool get_candidate_position(const UtilityCandidate& candidate, vec2& out_position)
+{
+	out_position = candidate.offset;
+	if (!candidate.has_target)
+		return true;
+	if (!registry.motions.has(candidate.target))
+		return false;
+	out_position += registry.motions.get(candidate.target).position;
+	return true;
+}
+
+float UtilityReasoner::score(const UtilityOption& option, const UtilityQuery& query) const
+{
+	// Without compensation every consideration below 1 would drag the product down
+	const float compensation = option.considerations.empty() ? 0.f : 1.f - 1.f / option.considerations.size();
+	float total = option.weight;
+	for (const Consideration& consideration : option.considerations)
+	{
+		const float value = consideration.curve.evaluate(consideration.input(query));
+		total *= value + (1.f - value) * compensation * value;
+		if (total <= 0.f)
+			return 0.f;
+	}
+	return total;
+}
+
+void UtilityReasoner::decide(UtilityQuery& query, UtilityDecision& decision)
+{
+	const int current_option = decision.option;
+	query.current_option = current_option;
+	Entity current_target = decision.candidate.target;
+	const bool current_has_target = decision.candidate.has_target;
+	decision.option = -1;
+	decision.score = 0.f;
+	decision.age_ms = 0.f;
+	for (int o = 0; o < (int)options.size(); o++)
+	{
+		const UtilityOption& option = options[o];
+		candidates.clear();
+		if (option.candidates != nullptr)
+			option.candidates(query, candidates);
+		else
+			candidates.push_back(UtilityCandidate());
+		for (UtilityCandidate& candidate : candidates)
+		{
+			query.candidate = candidate;
+			float candidate_score = score(option, query);
+			if (o == current_option && candidate.has_target == current_has_target &&
+				(!candidate.has_target || candidate.target == current_target))
+				candidate_score *= inertia;
+			if (candidate_score > decision.score)
+			{
+				decision.option = o;
+				decision.candidate = candidate;
+				decision.score = candidate_score;
+			}
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "components.hpp"
+
+class SpatialIndex;
+struct InfluenceMaps;
+
+enum class CURVE {
+	LINEAR = 0, // slope * (x - x_shift) + y_shift
+	POLYNOMIAL = LINEAR + 1, // slope * (x - x_shift)^exponent + y_shift
+	LOGISTIC = POLYNOMIAL + 1 // 1 / (1 + e^(-slope * (x - x_shift))) + y_shift
+};
+
+// Maps the input of a consideration in [0, 1] to a score in [0, 1]
+struct ResponseCurve
+{
+	CURVE type = CURVE::LINEAR;
+	float slope = 1.f;
+	float exponent = 1.f;
+	float x_shift = 0.f;
+	float y_shift = 0.f;
+
+	float evaluate(float x) const;
+};
+
+// What the candidate sources and considerations see
+struct UtilityQuery
+{
+	Entity agent;
+	vec2 position;
+	const SpatialIndex* index; // bodies of the last physics step, may be null
+	const InfluenceMaps* influence; // may be null
+	const float* option_share; // fraction of the agents that chose each option last time
+	UtilityCandidate candidate; // the one being scored
+	int current_option = -1; // of the agent before this evaluation, set by the reasoner
+};
+
+// Adds the candidates of an option for the agent of the query
+typedef void (*CandidateSource)(const UtilityQuery& query, std::vector<UtilityCandidate>& out_candidates);
+// Normalized input of a consideration in [0, 1]
+typedef float (*UtilityInput)(const UtilityQuery& query);
+
+struct Consideration
+{
+	UtilityInput input;
+	ResponseCurve curve;
+};
+
+// A kind of choice, every candidate scores the product of its considerations times 'weight'
+struct UtilityOption
+{
+	float weight = 1.f;
+	CandidateSource candidates = nullptr;
+	std::vector<Consideration> considerations;
+};
+
+// Picks the best candidate among all options for an agent. The product of the
+// considerations is compensated for their number, so options with more considerations
+// aren't penalized, and the current choice gets a bonus to keep agents from flip-flopping
+// between nearly equal candidates.
+class UtilityReasoner
+{
+public:
+	std::vector<UtilityOption> options;
+	float inertia = 1.2f; // score multiplier of the current choice
+
+	bool empty() const { return options.empty(); }
+
+	// Scores every candidate of every option and overwrites 'decision' with the best, an
+	// option of -1 if none scores above 0
+	void decide(UtilityQuery& query, UtilityDecision& decision);
+
+private:
+	float score(const UtilityOption& option, const UtilityQuery& query) const;
+
+	std::vector<UtilityCandidate> candidates;
+};
+
+// Position of the candidate's target, or the candidate's position without one. Returns
+// false if the target is gone.
+bool get_candidate_position(const UtilityCandidate& candidate, vec2& out_position);
@@ -0,0 +1,230 @@
+// internal
+#include "wind_system.hpp"
+#include "simd.hpp"
+
+// stlib
+#include <algorithm>
+
+// Blowers accelerate the air around them in a counterclockwise swirl and remove it at
+// this rate, both fall off linearly towards the edge of the blower
+const float SWIRL_ACCELERATION = 600.f; // pixels per second squared
+const float SINK_RATE = 4.f; // per second
+// Wind slows down by this factor per second once nothing drives it
+const float WIND_DAMPING = 1.5f;
+
+// Rows per job, the grid rows are short so a few are batched together
+const size_t ROW_GRAIN = 8;
+
+// Bilinear interpolation of a bordered field at cell coordinates, where the center of the
+// first interior cell is at (1, 1)
+static float bilinear(const float* field, int stride, float x, float y)
+{
+	const int x0 = (int)x;
+	const int y0 = (int)y;
+	const float fx = x - (float)x0;
+	const float fy = y - (float)y0;
+	const float* row = field + y0 * stride + x0;
+	const float top = row[0] + fx * (row[1] - row[0]);
+	const float bottom = row[stride] + fx * (row[stride + 1] - row[stride]);
+	return top + fy * (bottom - top);
+}
+
+WindSystem::WindSystem(int width_arg, int height_arg, JobSystem& jobs_arg)
+	: jobs(jobs_arg), width(width_arg), height(height_arg), stride(width_arg + 2)
+{
+	cell_size = { (float)window_width_px / width, (float)window_height_px / height };
+	const size_t cells = (size_t)stride * (height + 2);
+	velocity_x.assign(cells, 0.f);
+	velocity_y.assign(cells, 0.f);
+	advected_x.assign(cells, 0.f);
+	advected_y.assign(cells, 0.f);
+	pressure.assign(cells, 0.f);
+	next_pressure.assign(cells, 0.f);
+	divergence.assign(cells, 0.f);
+	sink.assign(cells, 0.f);
+}
+
+void WindSystem::reset()
+{
+	std::vector<float>* fields[] = { &velocity_x, &velocity_y, &advected_x, &advected_y, &pressure, &next_pressure, &divergence, &sink };
+	for (std::vector<float>* field : fields)
+		std::fill(field->begin(), field->end(), 0.f);
+}
+
+vec2 WindSystem::sample(vec2 position) const
+{
+	const float x = clamp(position.x / cell_size.x + 0.5f, 0.5f, width + 0.49f);
+	const float y = clamp(position.y / cell_size.y + 0.5f, 0.5f, height + 0.49f);
+	return { bilinear(velocity_x.data(), stride, x, y), bilinear(velocity_y.data(), stride, x, y) };
+}
+
+void WindSystem::add_blower(vec2 position, float radius, float elapsed_ms)
+{
+	const float dt = elapsed_ms / 1000.f;
+	const int x_begin = max(1, (int)((position.x - radius) / cell_size.x) + 1);
+	const int x_end = min(width, (int)((position.x + radius) / cell_size.x) + 1);
+	const int y_begin = max(1, (int)((position.y - radius) / cell_size.y) + 1);
+	const int y_end = min(height, (int)((position.y + radius) / cell_size.y) + 1);
+	for (int y = y_begin; y <= y_end; y++)
+	{
+		for (int x = x_begin; x <= x_end; x++)
+		{
+			const vec2 center = { (x - 0.5f) * cell_size.x, (y - 0.5f) * cell_size.y };
+			const vec2 offset = center - position;
+			const float distance = sqrt(dot(offset, offset));
+			if (distance >= radius || distance < 1e-3f)
+				continue;
+			const float falloff = 1.f - distance / radius;
+			// counterclockwise on screen, y points down
+			const vec2 tangent = vec2(offset.y, -offset.x) / distance;
+			const int i = index(x, y);
+			velocity_x[i] += dt * SWIRL_ACCELERATION * falloff * tangent.x;
+			velocity_y[i] += dt * SWIRL_ACCELERATION * falloff * tangent.y;
+			sink[i] += SINK_RATE * falloff;
+		}
+	}
+}
+
+void WindSystem::advect(float dt)
+{
+	// Trace every cell center back along the velocity and fetch what was there
+	const float damping = 1.f / (1.f + dt * WIND_DAMPING);
+	const vec2 cells_per_second = dt / cell_size;
+	jobs.parallel_for(height, ROW_GRAIN, [&](size_t begin, size_t end) {
+		for (int y = (int)begin + 1; y <= (int)end; y++)
+		{
+			for (int x = 1; x <= width; x++)
+			{
+				const int i = index(x, y);
+				const float from_x = clamp(x - cells_per_second.x * velocity_x[i], 0.5f, width + 0.49f);
+				const float from_y = clamp(y - cells_per_second.y * velocity_y[i], 0.5f, height + 0.49f);
+				advected_x[i] = damping * bilinear(velocity_x.data(), stride, from_x, from_y);
+				advected_y[i] = damping * bilinear(velocity_y.data(), stride, from_x, from_y);
+			}
+		}
+	});
+	velocity_x.swap(advected_x);
+	velocity_y.swap(advected_y);
+	set_velocity_border();
+}
+
+void WindSystem::project()
+{
+	const float inverse_width2 = 0.5f / cell_size.x;
+	const float inverse_height2 = 0.5f / cell_size.y;
+
+	// The projected field has divergence -sink, i.e., air flows into the blowers
+	jobs.parallel_for(height, ROW_GRAIN, [&](size_t begin, size_t end) {
+		for (int y = (int)begin + 1; y <= (int)end; y++)
+		{
+			for (int x = 1; x <= width; x++)
+			{
+				const int i = index(x, y);
+				divergence[i] = inverse_width2 * (velocity_x[i + 1] - velocity_x[i - 1]) +
+					inverse_height2 * (velocity_y[i + stride] - velocity_y[i - stride]) + sink[i];
+			}
+		}
+	});
+
+	// Jacobi iterations for laplace(pressure) = divergence, starting from the pressure of
+	// the last step. The border stays 0 so that air can enter and leave the window.
+	const float ax = 1.f / (cell_size.x * cell_size.x);
+	const float ay = 1.f / (cell_size.y * cell_size.y);
+	const float scale = 1.f / (2.f * ax + 2.f * ay);
+	for (int iteration = 0; iteration < pressure_iterations; iteration++)
+	{
+		jobs.parallel_for(height, ROW_GRAIN, [&](size_t begin, size_t end) {
+			const float4 ax4(ax), ay4(ay), scale4(scale);
+			for (int y = (int)begin + 1; y <= (int)end; y++)
+			{
+				const float* p = pressure.data() + index(0, y);
+				const float* b = divergence.data() + index(0, y);
+				float* out = next_pressure.data() + index(0, y);
+				int x = 1;
+				for (; x + 3 <= width; x += 4)
+				{
+					const float4 horizontal = float4::load(p + x - 1) + float4::load(p + x + 1);
+					const float4 vertical = float4::load(p + x - stride) + float4::load(p + x + stride);
+					(scale4 * (ax4 * horizontal + ay4 * vertical - float4::load(b + x))).store(out + x);
+				}
+				for (; x <= width; x++)
+					out[x] = scale * (ax * (p[x - 1] + p[x + 1]) + ay * (p[x - stride] + p[x + stride]) - b[x]);
+			}
+		});
+		pressure.swap(next_pressure);
+	}
+
+	// Subtract the pressure gradient
+	jobs.parallel_for(height, ROW_GRAIN, [&](size_t begin, size_t end) {
+		const float4 gx4(inverse_width2), gy4(inverse_height2);
+		for (int y = (int)begin + 1; y <= (int)end; y++)
+		{
+			const float* p = pressure.data() + index(0, y);
+			float* u = velocity_x.data() + index(0, y);
+			float* v = velocity_y.data() + index(0, y);
+			int x = 1;
+			for (; x + 3 <= width; x += 4)
+			{
+				(float4::load(u + x) - gx4 * (float4::load(p + x + 1) - float4::load(p + x - 1))).store(u + x);
+				(float4::load(v + x) - gy4 * (float4::load(p + x + stride) - float4::load(p + x - stride))).store(v + x);
+			}
+			for (; x <= width; x++)
+			{
+				u[x] -= inverse_width2 * (p[x + 1] - p[x - 1]);
+				v[x] -= inverse_height2 * (p[x + stride] - p[x - stride]);
+			}
+		}
+	});
+	set_velocity_border();
+}
+
+void WindSystem::set_velocity_border()
+{
+	// Zero gradient across the border, the wind blows straight out of the window
+	for (int x = 1; x <= width; x++)
+	{
+		velocity_x[index(x, 0)] = velocity_x[index(x, 1)];
+		velocity_y[index(x, 0)] = velocity_y[index(x, 1)];
+		velocity_x[index(x, height + 1)] = velocity_x[index(x, height)];
+		velocity_y[index(x, height + 1)] = velocity_y[index(x, height)];
+	}
+	for (int y = 0; y <= height + 1; y++)
+	{
+		velocity_x[index(0, y)] = velocity_x[index(1, y)];
+		velocity_y[index(0, y)] = velocity_y[index(1, y)];
+		velocity_x[index(width + 1, y)] = velocity_x[index(width, y)];
+		velocity_y[index(width + 1, y)] = velocity_y[index(width, y)];
+	}
+}
+
+void WindSystem::simulate(float elapsed_ms)
+{
+	const float dt = elapsed_ms / 1000.f;
+	if (dt <= 0.f)
+		return;
+	set_velocity_border();
+	advect(dt);
+	project();
+	std::fill(sink.begin(), sink.end(), 0.f);
+}
+
+void WindSystem::step(float elapsed_ms)
+{
+	// Vortices stir the air over an area a bit larger than their sprite
+	for (Entity entity : registry.blowers.entities)
+	{
+		if (!registry.motions.has(entity))
+			continue;
+		const Motion& motion = registry.motions.get(entity);
+		add_blower(motion.position, 0.75f * max(abs(motion.scale.x), abs(motion.scale.y)), elapsed_ms);
+	}
+
+	simulate(elapsed_ms);
+
+	for (uint i = 0; i < registry.blowables.size(); i++)
+	{
+		Entity entity = registry.blowables.entities[i];
+		if (registry.motions.has(entity))
+			registry.blowables.components[i].wind_velocity = sample(registry.motions.get(entity).position);
+	}
+}
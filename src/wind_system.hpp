@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "job_system.hpp"
+#include "tiny_ecs_registry.hpp"
+
+// Wind over the play area, simulated as a 2D incompressible fluid on a grid with the
+// stable fluids method (semi-Lagrangian advection and a pressure projection). Every Blower
+// stirs the air around it and sucks it in, every Blowable is carried along by the wind at
+// its position, see Blowable::wind_velocity. Rows are processed in parallel on the job
+// system and the pressure solve uses four float lanes (simd.hpp).
+class WindSystem
+{
+public:
+	// Grid of width x height cells stretched over the window
+	WindSystem(int width = 64, int height = 96, JobSystem& jobs = get_job_system());
+
+	void step(float elapsed_ms);
+	// Calms the air down everywhere
+	void reset();
+
+	// Wind velocity in pixels per second at a window position, bilinearly interpolated
+	vec2 sample(vec2 position) const;
+
+	// Adds the swirl and sink of a blower with the given radius at a window position
+	void add_blower(vec2 position, float radius, float elapsed_ms);
+
+	// Advances the field by elapsed_ms without looking at the registry, the blowers have to
+	// be added before
+	void simulate(float elapsed_ms);
+
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+
+	int pressure_iterations = 20;
+
+private:
+	// Index of cell (x, y), the grid has a border of one cell on every side
+	int index(int x, int y) const { return y * stride + x; }
+	void advect(float dt);
+	void project();
+	void set_velocity_border();
+
+	JobSystem& jobs;
+	int width;
+	int height;
+	int stride; // width + 2
+	vec2 cell_size;
+
+	std::vector<float> velocity_x;
+	std::vector<float> velocity_y;
+	std::vector<float> advected_x;
+	std::vector<float> advected_y;
+	std::vector<float> pressure;
+	std::vector<float> next_pressure;
+	std::vector<float> divergence;
+	// Rate at which blowers remove air in this step (1/s), the projection turns it into inflow
+	std::vector<float> sink;
+};
@@ -17,6 +17,9 @@ Entity createChicken(RenderSystem* renderer, vec2 pos)
 	motion.scale = mesh.original_size * 300.f;
 	motion.scale.y *= -1; // point front to the right
 
+	// The chicken can't leave the screen
+	registry.boundaries.insert(entity, { BOUNDARY_POLICY::CLAMP });
+
 	LightUp& light_up = registry.lightUps.emplace(entity);
 	MotionFlag& motion_flag = registry.motionFlags.emplace(entity);
 	// Create and (empty) Chicken component to be able to refer to all eagles
@@ -31,7 +34,7 @@ Entity createChicken(RenderSystem* renderer, vec2 pos)
 	return entity;
 }
 
-Entity createBug(RenderSystem* renderer, vec2 position)
+Entity createBug(RenderSystem* renderer, vec2 position, AGENT_ARCHETYPE archetype)
 {
 	// Reserve en entity
 	auto entity = Entity();
@@ -39,6 +42,8 @@ Entity createBug(RenderSystem* renderer, vec2 position)
 	// Store a reference to the potentially re-used mesh object
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
+	// Opaque pixels of the texture for the pixel accurate collision test
+	registry.alphaMaskPtrs.emplace(entity, &renderer->getAlphaMask(TEXTURE_ASSET_ID::BUG));
 
 	// Initialize the position, scale, and physics components
 	auto& motion = registry.motions.emplace(entity);
@@ -49,8 +54,12 @@ Entity createBug(RenderSystem* renderer, vec2 position)
 	// Setting initial values, scale is negative to make it face the opposite way
 	motion.scale = vec2({ -BUG_BB_WIDTH, BUG_BB_HEIGHT });
 
+	// Removed once it left the screen
+	registry.boundaries.emplace(entity);
+
 	// Create an (empty) Bug component to be able to refer to all bug
 	registry.eatables.emplace(entity);
+	registry.aiAgents.insert(entity, { archetype });
 	registry.blowables.emplace(entity);
 	registry.renderRequests.insert(
 		entity,
@@ -68,6 +77,8 @@ Entity createEagle(RenderSystem* renderer, vec2 position)
 	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
+	// Opaque pixels of the texture for the pixel accurate collision test
+	registry.alphaMaskPtrs.emplace(entity, &renderer->getAlphaMask(TEXTURE_ASSET_ID::EAGLE));
 
 	// Initialize the motion
 	auto& motion = registry.motions.emplace(entity);
@@ -80,9 +91,13 @@ Entity createEagle(RenderSystem* renderer, vec2 position)
 	// Setting initial values, scale is negative to make it face the opposite way
 	motion.scale = vec2({ -EAGLE_BB_WIDTH, EAGLE_BB_HEIGHT });
 
+	// Removed once it left the screen
+	registry.boundaries.emplace(entity);
+
 	// Create and (empty) Eagle component to be able to refer to all eagles
 	registry.deadlys.emplace(entity);
 	registry.blowables.emplace(entity);
+	registry.aiAgents.insert(entity, { AGENT_ARCHETYPE::EAGLE });
 	registry.renderRequests.insert(
 		entity,
 		{ TEXTURE_ASSET_ID::EAGLE,
@@ -125,6 +140,12 @@ Entity createEgg(vec2 pos, vec2 size)
 	motion.velocity = { 0.f, 0.f };
 	motion.scale = size;
 
+	// Eggs fall, roll and pile up, simulated by the rigid body solver (the egg mesh is a
+	// circle of diameter 1 before scaling)
+	RigidBody& body = registry.rigidBodies.emplace(entity);
+	body.radius = abs(size.x) / 2.f;
+	body.inverse_mass = 1.f / (body.radius * body.radius);
+
 	// Create and (empty) Chicken component to be able to refer to all eagles
 	registry.deadlys.emplace(entity);
 	registry.renderRequests.insert(
@@ -159,6 +180,9 @@ Entity createVortex(RenderSystem* renderer, vec2 position)
 	// Setting initial values, scale is negative to make it face the opposite way
 	motion.scale = vec2({ -VORTEX_BB_WIDTH, VORTEX_BB_HEIGHT });
 
+	// Removed once it left the screen
+	registry.boundaries.emplace(entity);
+
 	// Create and (empty) Vortex component to be able to refer to all vortices
 	registry.blowers.emplace(entity);
 	registry.renderRequests.insert(
@@ -177,6 +201,8 @@ Entity createStone(RenderSystem* renderer, vec2 position, float rand)
 	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
+	// Opaque pixels of the texture for the pixel accurate collision test
+	registry.alphaMaskPtrs.emplace(entity, &renderer->getAlphaMask(TEXTURE_ASSET_ID::STONE));
 
 	// Initialize the motion
 	auto& motion = registry.motions.emplace(entity);
@@ -187,8 +213,13 @@ Entity createStone(RenderSystem* renderer, vec2 position, float rand)
 	// Setting initial values, scale is negative to make it face the opposite way
 	motion.scale = rand * vec2({ -STONE_BB_WIDTH, STONE_BB_HEIGHT }) + vec2({ -STONE_BB_WIDTH, STONE_BB_HEIGHT });
 
+	// Removed once it left the screen
+	registry.boundaries.emplace(entity);
+
 	// Create and (empty) Vortex component to be able to refer to all vortices
 	registry.deadlys.emplace(entity);
+	// Eagles fly around stones
+	registry.obstacles.emplace(entity);
 	registry.renderRequests.insert(
 		entity,
 		{ TEXTURE_ASSET_ID::STONE,
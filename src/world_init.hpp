@@ -17,8 +17,8 @@ const float STONE_BB_HEIGHT = 0.6f * 100.f;
 
 // the player
 Entity createChicken(RenderSystem* renderer, vec2 pos);
-// the prey
-Entity createBug(RenderSystem* renderer, vec2 position);
+// the prey, SWARM_BUG ones flock
+Entity createBug(RenderSystem* renderer, vec2 position, AGENT_ARCHETYPE archetype = AGENT_ARCHETYPE::BUG);
 // the enemy
 Entity createEagle(RenderSystem* renderer, vec2 position);
 // a red line for debugging purposes
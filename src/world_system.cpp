@@ -1,6 +1,7 @@
 // Header
 #include "world_system.hpp"
 #include "world_init.hpp"
+#include "debug_draw.hpp"
 
 // stlib
 #include <cassert>
@@ -14,6 +15,9 @@
 // Game configuration
 const size_t MAX_EAGLES = 15;
 const size_t MAX_BUG = 5;
+const size_t MAX_SWARM_BUG = 80;
+const size_t SWARM_SIZE = 16; // bugs spawned together in the swarm mode
+const float SWARM_SPREAD = 60.f;
 const size_t MAX_VORTEX = 1;
 const size_t MAX_STONE = 10;
 const size_t EAGLE_DELAY_MS = 2000 * 3;
@@ -23,6 +27,7 @@ const size_t STONE_DELAY_MS = 2000 * 3;
 struct Mode 
 {
 	bool advance = false;
+	bool swarm = false; // bugs come in flocks
 } mode;
 
 // Create the bug world
@@ -126,8 +131,9 @@ GLFWwindow* WorldSystem::create_window() {
 	return window;
 }
 
-void WorldSystem::init(RenderSystem* renderer_arg) {
+void WorldSystem::init(RenderSystem* renderer_arg, WindSystem* wind_arg) {
 	this->renderer = renderer_arg;
+	this->wind = wind_arg;
 	// Playing background music indefinitely
 	Mix_PlayMusic(background_music, -1);
 	fprintf(stderr, "Loaded music\n");
@@ -147,20 +153,11 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	// Remove debug info from the last step
 	while (registry.debugComponents.entities.size() > 0)
 		registry.remove_all_components_of(registry.debugComponents.entities.back());
+	debug_draw_clear();
 
-	// Removing out of screen entities
-	auto& motions_registry = registry.motions;
-
-	// Remove entities that leave the screen on the left side
-	// Iterate backwards to be able to remove without unterfering with the next object to visit
-	// (the containers exchange the last element with the current)
-	for (int i = (int)motions_registry.components.size() - 1; i >= 0; --i) {
-		Motion& motion = motions_registry.components[i];
-		if (motion.position.x + abs(motion.scale.x) < 0.f) {
-			if (!registry.players.has(motions_registry.entities[i])) // don't remove the player
-				registry.remove_all_components_of(motions_registry.entities[i]);
-		}
-	}
+	// Remove the entities the physics system found to have left the screen
+	while (registry.outOfBounds.entities.size() > 0)
+		registry.remove_all_components_of(registry.outOfBounds.entities.back());
 
 	// Spawning new eagles
 	next_eagle_spawn -= elapsed_ms_since_last_update * current_speed;
@@ -173,13 +170,24 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 
 	// Spawning new bugs
 	next_bug_spawn -= elapsed_ms_since_last_update * current_speed;
-	if (registry.eatables.components.size() <= MAX_BUG && next_bug_spawn < 0.f) {
+	// a whole flock has to fit under the limit in the swarm mode
+	const bool room_for_bugs = mode.swarm ? registry.eatables.components.size() + SWARM_SIZE <= MAX_SWARM_BUG :
+		registry.eatables.components.size() <= MAX_BUG;
+	if (room_for_bugs && next_bug_spawn < 0.f) {
 		// !!!  TODO A1: Create new bug with createBug({0,0}), as for the Eagles above
 		// Reset timer
 		next_bug_spawn = (BUG_DELAY_MS / 2) + uniform_dist(rng) * (BUG_DELAY_MS / 2);
 		// Create bug with random initial position
-		createBug(renderer, vec2(50.f + uniform_dist(rng) * (window_width_px - 100.f),
-			-100.f)); // 2nd param sets how far offscreen
+		const vec2 position = vec2(50.f + uniform_dist(rng) * (window_width_px - 100.f),
+			-100.f); // 2nd param sets how far offscreen
+		if (mode.swarm) {
+			// A whole flock around the position
+			for (size_t i = 0; i < SWARM_SIZE; i++)
+				createBug(renderer, position + SWARM_SPREAD * vec2(uniform_dist(rng) - 0.5f, uniform_dist(rng) - 0.5f),
+					AGENT_ARCHETYPE::SWARM_BUG);
+		}
+		else
+			createBug(renderer, position);
 	}
 
 	if (mode.advance) {
@@ -314,6 +322,10 @@ void WorldSystem::restart_game() {
 	while (registry.motions.entities.size() > 0)
 	    registry.remove_all_components_of(registry.motions.entities.back());
 
+	// The vortices are gone, so is their wind
+	if (wind != nullptr)
+		wind->reset();
+
 	// Debugging for memory/component leaks
 	registry.list_all_components();
 
@@ -345,6 +357,12 @@ void WorldSystem::handle_collisions() {
 		Entity entity = collisionsRegistry.entities[i];
 		Entity entity_other = collisionsRegistry.components[i].other;
 
+		// Only react when a contact begins, physics doesn't repeat ongoing contacts except for
+		// the bugs, which the chicken can only eat once it stopped lighting up
+		const CONTACT_EVENT event = collisionsRegistry.components[i].event;
+		if (event == CONTACT_EVENT::END || (event == CONTACT_EVENT::STAY && !registry.eatables.has(entity_other)))
+			continue;
+
 		// For now, we are only interested in collisions that involve the chicken
 		if (registry.players.has(entity)) {
 			//Player& player = registry.players.get(entity);
@@ -366,6 +384,9 @@ void WorldSystem::handle_collisions() {
 					motion_flag.alive = false;
 					motion.angle = M_PI / 2.f;
 					motion.velocity = vec2(0.f, 100.f * current_speed);
+					// and let it sink out of the window instead of landing on the bottom edge
+					if (registry.boundaries.has(entity))
+						registry.boundaries.get(entity).policy = BOUNDARY_POLICY::NONE;
 					//motion.position += vec2(0.f, 5.f);
 				}
 			}
@@ -388,16 +409,13 @@ void WorldSystem::handle_collisions() {
 			if (registry.blowables.has(entity)) {
 				// Checking Blowable - Blower collisions
 				if (registry.blowers.has(entity_other)) {
+					// the pull towards the blower comes from the wind, see WindSystem
 					if (!registry.blowUpTimers.has(entity)) {
 						registry.blowUpTimers.emplace(entity);
-						Motion& motion = registry.motions.get(entity);
-						Motion& motion_other = registry.motions.get(entity_other);
 						if (registry.motionFlags.has(entity)) {
 							MotionFlag& motion_flag = registry.motionFlags.get(entity);
 							motion_flag.dragged = true;
 						}
-						vec2 diff = motion.position - motion_other.position;
-						motion.velocity = -1.5f * diff;
 					}
 				}
 			}
@@ -447,6 +465,13 @@ void WorldSystem::on_key(int key, int, int action, int mod) {
 		restart_game();
 	}
 
+	// Toggle the bug swarms with `S`
+	if (action == GLFW_RELEASE && key == GLFW_KEY_S) {
+		mode.swarm = !mode.swarm;
+		printf("Swarm Mode %s\n", mode.swarm ? "on" : "off");
+		restart_game();
+	}
+
 	// Debugging
 	if (key == GLFW_KEY_D) {
 		if (action == GLFW_RELEASE)
@@ -455,6 +480,10 @@ void WorldSystem::on_key(int key, int, int action, int mod) {
 			debugging.in_debug_mode = true;
 	}
 
+	// Toggle the per-step physics counters log with `P`
+	if (action == GLFW_RELEASE && key == GLFW_KEY_P)
+		debugging.log_physics_stats = !debugging.log_physics_stats;
+
 	// Control the current speed with `<` `>`
 	if (action == GLFW_RELEASE && (mod & GLFW_MOD_SHIFT) && key == GLFW_KEY_COMMA) {
 		current_speed -= 0.1f;
@@ -12,6 +12,7 @@
 #include <SDL_mixer.h>
 
 #include "render_system.hpp"
+#include "wind_system.hpp"
 
 // Container for all our entities and game logic. Individual rendering / update is
 // deferred to the relative update() methods
@@ -23,8 +24,8 @@ public:
 	// Creates a window
 	GLFWwindow* create_window();
 
-	// starts the game
-	void init(RenderSystem* renderer);
+	// starts the game, the wind is calmed down on every restart
+	void init(RenderSystem* renderer, WindSystem* wind);
 
 	// Releases all associated resources
 	~WorldSystem();
@@ -53,6 +54,7 @@ private:
 
 	// Game state
 	RenderSystem* renderer;
+	WindSystem* wind = nullptr;
 	float current_speed;
 	float next_eagle_spawn;
 	float next_bug_spawn;